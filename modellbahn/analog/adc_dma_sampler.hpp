@@ -0,0 +1,216 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <modm/platform.hpp>
+
+/// @brief Samples a list of ADC channels with scan mode and DMA, a drop-in for modm::AdcSampler.
+/// @details The ADC converts the channels one after the other in scan mode and the DMA writes the
+/// results into a circular buffer of two halves, each holding Oversamples scans. Whenever a half
+/// is full its interrupt averages it in one batch while the DMA fills the other half, so a
+/// readout takes two interrupts instead of one per conversion. The scans run back to back or
+/// start with an external trigger, see set_trigger(). startReadout() only asks for the next
+/// completed half to be averaged into the data. Every completed half can also be handed on as a
+/// whole, see set_block_handler().
+/// @tparam Adc The ADC, e.g. Adc1.
+/// @tparam Dma The DMA channel mapped to the ADC, e.g. Dma2::Channel0.
+/// @tparam Channels The number of channels in the scan sequence.
+/// @tparam Oversamples The number of scans averaged into one readout.
+/// @tparam SampleTime The default sample time of the channels, the temperature sensor needs at least 10 µs.
+template <typename Adc, typename Dma, uint8_t Channels, uint32_t Oversamples = 1,
+          typename Adc::SampleTime SampleTime = Adc::SampleTime::Cycles480>
+class adc_dma_sampler
+{
+    static_assert(Channels > 0 and Channels <= 16, "A scan sequence has 1 to 16 channels");
+    static_assert(Oversamples > 0, "Every channel has to be sampled at least once");
+
+public:
+    using Channel = typename Adc::Channel;
+    using sample_time = typename Adc::SampleTime;
+
+    /// @brief Receives a completed half of the buffer in the DMA interrupt.
+    /// @details The scans hold Channels values each in the order of the mapping. They are
+    /// overwritten once the other half is full, so the handler has to take them over at once.
+    using block_handler = void (*)(const uint16_t *scans, size_t count);
+
+    /// @brief The type of the averages, the same as modm::AdcSampler chooses.
+    using DataType = std::conditional_t<
+        ((uint64_t(1) << Adc::Resolution) * Oversamples < (1u << 16)),
+        std::conditional_t<((uint64_t(1) << Adc::Resolution) * Oversamples < (1u << 8)), uint8_t, uint16_t>,
+        uint32_t>;
+
+    /// @brief The number of conversions in one half of the DMA buffer.
+    static constexpr size_t half_size = Channels * Oversamples;
+
+    static_assert(2 * half_size <= 0xffff, "The DMA transfers at most 65535 samples");
+
+    /// @brief Programs the scan sequence with the default sample time and starts the conversions.
+    /// @details Call after Adc::initialize() and Dma controller enable().
+    /// @param mapping Channels channels in the order of the data, only read during the call.
+    /// @param data Channels averages, must outlive the sampler.
+    /// @param priority The priority of the DMA interrupt.
+    static void initialize(const Channel *mapping, DataType *data, const uint32_t priority = 5)
+    {
+        std::array<sample_time, Channels> sample_times;
+        sample_times.fill(SampleTime);
+        initialize(mapping, sample_times.data(), data, priority);
+    }
+
+    /// @brief Programs the scan sequence and starts the conversions.
+    /// @param mapping Channels channels in the order of the data, only read during the call.
+    /// @param sample_times The sample time of each channel, only read during the call.
+    /// @param data Channels averages, must outlive the sampler.
+    /// @param priority The priority of the DMA interrupt.
+    static void initialize(const Channel *mapping, const sample_time *sample_times, DataType *data, const uint32_t priority = 5)
+    {
+        result = data;
+        requested = false;
+        finished = false;
+
+        Adc::setChannel(mapping[0], sample_times[0]);
+        for (size_t i = 1; i < Channels; ++i)
+        {
+            Adc::addChannel(mapping[i], sample_times[i]);
+        }
+        if constexpr (Channels > 1)
+        {
+            Adc::enableScanMode();
+        }
+
+        Dma::configure(Dma::DataTransferDirection::PeripheralToMemory, Dma::MemoryDataSize::HalfWord,
+                       Dma::PeripheralDataSize::HalfWord, Dma::MemoryIncrementMode::Increment,
+                       Dma::PeripheralIncrementMode::Fixed, Dma::Priority::High, Dma::CircularMode::Enabled);
+        Dma::template setPeripheralRequest<Dma::template RequestMapping<modm::platform::Peripheral::Adc1>::Request>();
+        Dma::setPeripheralAddress(Adc::getDataRegisterAddress());
+        Dma::setMemoryAddress(uintptr_t(buffer.data()));
+        Dma::setDataLength(buffer.size());
+        Dma::setHalfTransferCompleteIrqHandler(handle_half_transfer);
+        Dma::setTransferCompleteIrqHandler(handle_transfer_complete);
+        Dma::setTransferErrorIrqHandler(handle_error);
+        Dma::enableInterrupt(Dma::InterruptEnable::HalfTransfer | Dma::InterruptEnable::TransferComplete |
+                             Dma::InterruptEnable::TransferError);
+        Dma::enableInterruptVector(priority);
+
+        start();
+    }
+
+    /// @brief Starts every scan with an external event instead of running them back to back.
+    /// @details Call before initialize(). A scan has to complete before the next event, events
+    /// during a scan are ignored by the ADC.
+    /// @param polarity The edge of the event which starts a scan.
+    /// @param event The event, see the external trigger table of the ADC in the reference manual.
+    static void set_trigger(const typename Adc::ExternalTriggerPolarity polarity,
+                            const typename Adc::RegularConversionExternalTrigger event)
+    {
+        trigger_polarity = polarity;
+        trigger_event = event;
+        triggered = true;
+    }
+
+    /// @brief Asks for the average of the next completed half.
+    /// @return False if a readout is in progress already.
+    static bool startReadout()
+    {
+        if (requested)
+        {
+            return false;
+        }
+        finished = false;
+        requested = true;
+        return true;
+    }
+
+    /// @brief Checks if the requested averages are in the data, which stays unchanged until the next startReadout().
+    static bool isReadoutFinished() { return finished; }
+
+    static DataType *getData() { return result; }
+
+    /// @brief Sets a function called with every completed half, e.g. to stream all samples.
+    static void set_block_handler(const block_handler handler)
+    {
+        Dma::disableInterrupt(Dma::InterruptEnable::HalfTransfer | Dma::InterruptEnable::TransferComplete);
+        on_block = handler;
+        Dma::enableInterrupt(Dma::InterruptEnable::HalfTransfer | Dma::InterruptEnable::TransferComplete);
+    }
+
+    /// @brief Number of times the DMA stopped with an error and the conversions were restarted.
+    static uint32_t errors() { return error_count; }
+
+private:
+    /// @brief Restarts the DMA at the beginning of the buffer and the conversions with it.
+    static void start()
+    {
+        Adc::disableDmaMode();
+        Dma::stop();
+        Dma::setMemoryAddress(uintptr_t(buffer.data()));
+        Dma::setDataLength(buffer.size());
+        Dma::start();
+        // Request the DMA after every conversion, not only the first sequence
+        Adc::enableDmaMode();
+        Adc::enableDmaRequests();
+        // An overrun stops the DMA requests until it is cleared
+        Adc::acknowledgeInterruptFlags(Adc::InterruptFlag::Overrun);
+        if (triggered)
+        {
+            Adc::disableFreeRunningMode();
+            Adc::enableRegularConversionExternalTrigger(trigger_polarity, trigger_event);
+        }
+        else
+        {
+            Adc::enableFreeRunningMode();
+            Adc::startConversion();
+        }
+    }
+
+    static void complete(const uint16_t *samples)
+    {
+        if (on_block)
+        {
+            on_block(samples, Oversamples);
+        }
+        average(samples);
+    }
+
+    static void average(const uint16_t *samples)
+    {
+        if (not requested)
+        {
+            return;
+        }
+        std::array<uint32_t, Channels> sums{};
+        for (size_t i = 0; i < half_size; i += Channels)
+        {
+            for (size_t channel = 0; channel < Channels; ++channel)
+            {
+                sums[channel] += samples[i + channel];
+            }
+        }
+        for (size_t channel = 0; channel < Channels; ++channel)
+        {
+            result[channel] = static_cast<DataType>(sums[channel] / Oversamples);
+        }
+        requested = false;
+        finished = true;
+    }
+
+    static void handle_half_transfer() { complete(buffer.data()); }
+
+    static void handle_transfer_complete() { complete(buffer.data() + half_size); }
+
+    static void handle_error()
+    {
+        ++error_count;
+        start();
+    }
+
+    alignas(uint32_t) static inline std::array<uint16_t, 2 * half_size> buffer{};
+    static inline DataType *result = nullptr;
+    static inline block_handler on_block = nullptr;
+    static inline volatile bool requested = false;
+    static inline volatile bool finished = false;
+    static inline uint32_t error_count = 0;
+    static inline bool triggered = false;
+    static inline typename Adc::ExternalTriggerPolarity trigger_polarity{};
+    static inline typename Adc::RegularConversionExternalTrigger trigger_event{};
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include <modm/platform/device.hpp>
+#define MODELLBAHN_DSP_SIMD 1
+#else
+#define MODELLBAHN_DSP_SIMD 0
+#endif
+
+/// @brief The Cortex-M4 SIMD instructions used by the filters, see filters.hpp.
+/// @details Two 16 bit values are packed into a word, the first one in the lower half. On the
+/// target the functions are the CMSIS intrinsics, elsewhere they are computed in plain C++ with
+/// exactly the same results, including the wrap around of the sums.
+namespace dsp
+{
+    /// @brief Packs two values into a word, low into the lower half.
+    constexpr uint32_t pack(const int16_t low, const int16_t high)
+    {
+        return uint32_t(uint16_t(low)) | (uint32_t(uint16_t(high)) << 16);
+    }
+
+    constexpr int16_t low(const uint32_t pair) { return static_cast<int16_t>(pair & 0xffff); }
+    constexpr int16_t high(const uint32_t pair) { return static_cast<int16_t>(pair >> 16); }
+
+    /// @brief Loads two consecutive values, the address need not be aligned.
+    inline uint32_t load_pair(const int16_t *values)
+    {
+        uint32_t pair;
+        std::memcpy(&pair, values, sizeof(pair));
+        return pair;
+    }
+
+    /// @brief Adds the halves separately, wrapping around.
+    inline uint32_t sadd16(const uint32_t a, const uint32_t b)
+    {
+#if MODELLBAHN_DSP_SIMD
+        return __SADD16(a, b);
+#else
+        return pack(static_cast<int16_t>(low(a) + low(b)), static_cast<int16_t>(high(a) + high(b)));
+#endif
+    }
+
+    /// @brief Subtracts the halves separately, wrapping around.
+    inline uint32_t ssub16(const uint32_t a, const uint32_t b)
+    {
+#if MODELLBAHN_DSP_SIMD
+        return __SSUB16(a, b);
+#else
+        return pack(static_cast<int16_t>(low(a) - low(b)), static_cast<int16_t>(high(a) - high(b)));
+#endif
+    }
+
+    /// @brief Multiplies the halves and adds both products to the accumulator, wrapping around.
+    inline int32_t smlad(const uint32_t a, const uint32_t b, const int32_t accumulator)
+    {
+#if MODELLBAHN_DSP_SIMD
+        return static_cast<int32_t>(__SMLAD(a, b, uint32_t(accumulator)));
+#else
+        const auto sum = uint32_t(accumulator) + uint32_t(int32_t(low(a)) * low(b)) + uint32_t(int32_t(high(a)) * high(b));
+        return static_cast<int32_t>(sum);
+#endif
+    }
+
+    /// @brief Saturates to the range of int16_t.
+    inline int16_t saturate16(const int32_t value)
+    {
+#if MODELLBAHN_DSP_SIMD
+        return static_cast<int16_t>(__SSAT(value, 16));
+#else
+        return static_cast<int16_t>(value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value);
+#endif
+    }
+}
@@ -0,0 +1,292 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include "dsp.hpp"
+
+/// @brief Copies one channel of streamed samples into a block for the filters.
+/// @param samples Samples with an array of values, e.g. from sample_stream::peek().
+/// @param channel The index of the channel.
+/// @param out samples.size() values.
+template <typename Sample>
+void channel_values(const std::span<const Sample> samples, const size_t channel, int16_t *out)
+{
+    for (const auto &sample : samples)
+    {
+        *out++ = static_cast<int16_t>(sample.values[channel]);
+    }
+}
+
+/// @brief Average of the last N values.
+/// @details Keeps a running sum, two values at a time: the differences of the new and the
+/// dropped pair are formed with one SIMD subtraction. The values must lie within ±16383 so
+/// that the differences fit into 16 bits, the 12 bit ADC values always do.
+/// @tparam N The length of the window, a power of two of at least 2.
+template <size_t N>
+class moving_average
+{
+    static_assert(N >= 2 and (N & (N - 1)) == 0, "The window must be a power of two");
+    static_assert(N <= 65536, "The sum must fit into 32 bits");
+
+public:
+    /// @brief Filters a block, in and out may be the same.
+    void process(const int16_t *in, int16_t *out, size_t count)
+    {
+        // Pairs need an even position in the history
+        if (count > 0 and (position & 1))
+        {
+            step(*in++, *out++);
+            --count;
+        }
+        for (; count >= 2; count -= 2, in += 2, out += 2)
+        {
+            const auto values = dsp::load_pair(in);
+            const auto difference = dsp::ssub16(values, dsp::load_pair(&history[position]));
+            std::memcpy(&history[position], &values, sizeof(values));
+            position = (position + 2) & (N - 1);
+            sum += dsp::low(difference);
+            out[0] = average();
+            sum += dsp::high(difference);
+            out[1] = average();
+        }
+        if (count > 0)
+        {
+            step(*in, *out);
+        }
+    }
+
+    /// @brief Clears the window.
+    void reset()
+    {
+        history = {};
+        position = 0;
+        sum = 0;
+    }
+
+private:
+    void step(const int16_t value, int16_t &out)
+    {
+        sum += value - history[position];
+        history[position] = value;
+        position = (position + 1) & (N - 1);
+        out = average();
+    }
+
+    int16_t average() const
+    {
+        return static_cast<int16_t>((sum + int32_t(N / 2)) >> std::countr_zero(N));
+    }
+
+    alignas(uint32_t) std::array<int16_t, N> history{};
+    size_t position = 0;
+    int32_t sum = 0;
+};
+
+/// @brief Exponential moving average, y += (x - y) / 2^shift.
+/// @details Keeps its state with 16 fractional bits, so small steps are not lost. Each output
+/// depends on the previous one, so there is nothing to vectorize.
+class ema_filter
+{
+public:
+    /// @param shift The smoothing, the time constant is about 2^shift samples, 0 to 15.
+    explicit constexpr ema_filter(const uint8_t shift) : shift(shift) {}
+
+    void process(const int16_t *in, int16_t *out, const size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            state += static_cast<int32_t>((int64_t(in[i]) * 65536 - state) >> shift);
+            out[i] = static_cast<int16_t>((int64_t(state) + 0x8000) >> 16);
+        }
+    }
+
+    /// @brief Starts at a value instead of converging from zero.
+    void reset(const int16_t value = 0) { state = int32_t(value) * 65536; }
+
+private:
+    uint8_t shift;
+    int32_t state = 0;
+};
+
+/// @brief Second order IIR section, direct form I with Q14 coefficients.
+/// @details y = (b0 x0 + b1 x1 + b2 x2 - a1 y1 - a2 y2) / 2^14, rounded and saturated. The five
+/// products are summed with three dual multiply-accumulates of prepacked coefficients.
+class biquad
+{
+public:
+    /// @brief Coefficients in Q14, so 16384 is 1.0 and the range is -2.0 < c < 2.0.
+    struct coefficients
+    {
+        int16_t b0, b1, b2, a1, a2;
+    };
+
+    static constexpr int fraction_bits = 14;
+
+    /// @brief Rounds floating point coefficients to Q14 at compile time.
+    static consteval coefficients from_float(const double b0, const double b1, const double b2, const double a1, const double a2)
+    {
+        const auto q = [](const double value)
+        {
+            const auto scaled = value * (1 << fraction_bits);
+            return static_cast<int16_t>(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+        };
+        return {q(b0), q(b1), q(b2), q(a1), q(a2)};
+    }
+
+    /// @param c The coefficients, a1 and a2 must be greater than -2.0 to be negated in Q14.
+    explicit constexpr biquad(const coefficients &c)
+        : b01(dsp::pack(c.b0, c.b1)),
+          b2_a1(dsp::pack(c.b2, static_cast<int16_t>(-c.a1))),
+          a2(dsp::pack(static_cast<int16_t>(-c.a2), 0))
+    {
+    }
+
+    /// @brief Filters a block, in and out may be the same.
+    void process(const int16_t *in, int16_t *out, const size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto x0 = in[i];
+            int32_t accumulator = 1 << (fraction_bits - 1);
+            accumulator = dsp::smlad(dsp::pack(x0, x1), b01, accumulator);
+            accumulator = dsp::smlad(dsp::pack(x2, y1), b2_a1, accumulator);
+            accumulator = dsp::smlad(dsp::pack(y2, 0), a2, accumulator);
+            const auto y0 = dsp::saturate16(accumulator >> fraction_bits);
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            out[i] = y0;
+        }
+    }
+
+    void reset() { x1 = x2 = y1 = y2 = 0; }
+
+private:
+    uint32_t b01;
+    uint32_t b2_a1;
+    uint32_t a2;
+    int16_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+};
+
+/// @brief Median of the last N values, removes single spikes without smearing edges.
+/// @details Sorts a copy of the window for every value. Order statistics do not map onto the
+/// SIMD instructions, so this is scalar on every platform. The window starts filled with the
+/// first value.
+/// @tparam N The length of the window, odd and small.
+template <size_t N>
+class median_filter
+{
+    static_assert(N % 2 == 1 and N <= 15, "The window must be odd and small");
+
+public:
+    /// @brief Filters a block, in and out may be the same.
+    void process(const int16_t *in, int16_t *out, const size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (not primed)
+            {
+                window.fill(in[i]);
+                primed = true;
+            }
+            window[position] = in[i];
+            position = position + 1 < N ? position + 1 : 0;
+
+            auto sorted = window;
+            // Insertion sort, few compares for the small windows
+            for (size_t j = 1; j < N; ++j)
+            {
+                const auto value = sorted[j];
+                size_t k = j;
+                for (; k > 0 and sorted[k - 1] > value; --k)
+                {
+                    sorted[k] = sorted[k - 1];
+                }
+                sorted[k] = value;
+            }
+            out[i] = sorted[N / 2];
+        }
+    }
+
+    void reset()
+    {
+        primed = false;
+        position = 0;
+    }
+
+private:
+    std::array<int16_t, N> window{};
+    size_t position = 0;
+    bool primed = false;
+};
+
+/// @brief Averages every Factor values into one, reducing the rate of a stream.
+/// @details Groups may span blocks. A group which lies within a block is summed two values at a
+/// time with a dual multiply-accumulate by one.
+/// @tparam Factor The number of values per output.
+template <size_t Factor>
+class decimator
+{
+    static_assert(Factor >= 1 and Factor <= 65536, "The sum must fit into 32 bits");
+
+public:
+    /// @brief Filters a block.
+    /// @param out At least count / Factor + 1 values.
+    /// @return The number of values written to out.
+    size_t process(const int16_t *in, int16_t *out, size_t count)
+    {
+        size_t written = 0;
+        while (count > 0)
+        {
+            if (accumulated == 0 and count >= Factor)
+            {
+                int32_t group = 0;
+                size_t i = 0;
+                for (; i + 1 < Factor; i += 2)
+                {
+                    group = dsp::smlad(dsp::load_pair(in + i), ones, group);
+                }
+                if constexpr (Factor % 2 == 1)
+                {
+                    group += in[i];
+                }
+                out[written++] = average(group);
+                in += Factor;
+                count -= Factor;
+                continue;
+            }
+            sum += *in++;
+            --count;
+            if (++accumulated == Factor)
+            {
+                out[written++] = average(sum);
+                accumulated = 0;
+                sum = 0;
+            }
+        }
+        return written;
+    }
+
+    void reset()
+    {
+        accumulated = 0;
+        sum = 0;
+    }
+
+private:
+    static constexpr uint32_t ones = dsp::pack(1, 1);
+
+    static int16_t average(const int32_t group)
+    {
+        // Rounds half away from zero for either sign
+        const auto half = int32_t(Factor / 2);
+        return static_cast<int16_t>((group < 0 ? group - half : group + half) / int32_t(Factor));
+    }
+
+    size_t accumulated = 0;
+    int32_t sum = 0;
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <modm/platform.hpp>
+#include <modm/architecture/interface/clock.hpp>
+#include "trip_recovery.hpp"
+
+/// @brief Cuts a motor driver in the ADC interrupt when its current exceeds a threshold.
+/// @details The analog watchdog of Adc1 compares every conversion of the current channel with
+/// the threshold in hardware. Its interrupt pulls the enable of the driver low and switches off
+/// the outputs of the PWM timer right away, without any fiber involved, and then records the
+/// trip. update() runs in a fiber, hands the trip to the recovery policy and restores the
+/// outputs when the policy says so. The watchdog only sees the conversions the ADC makes, see
+/// adc_dma_sampler. On the adapter the scans are started by channel 2 of Timer1 once per DCC
+/// bit, so a current which rises right after a sample is only seen with the next scan: one bit
+/// later, 116 µs after a one and 200 µs after a zero, plus the conversion of the current of
+/// about 4 µs. That bounds the time to a trip, not the cycles of the interrupt. The latency
+/// recorded with a trip only counts the CPU cycles from the exception entry to the cut
+/// outputs, the time until the sample and a running interrupt of the same priority add to it.
+/// @tparam Enable The enable pin of the driver.
+/// @tparam Timer The advanced timer driving the inputs of the driver.
+/// @tparam SystemClock The clock of the CPU, to convert the measured latency.
+template <typename Enable, typename Timer, typename SystemClock>
+class overcurrent_trip
+{
+public:
+    using recovery_type = trip_recovery<modm::PreciseClock>;
+
+    /// @brief When the outputs are restored, may be changed before initialize().
+    static inline recovery_type recovery;
+
+    /// @brief Starts watching the channel.
+    /// @param channel The channel of the current.
+    /// @param threshold The highest allowed value in ADC counts.
+    /// @param priority The priority of the ADC interrupt, above everything which may delay the trip.
+    static void initialize(const modm::platform::Adc1::Channel channel, const uint16_t threshold, const uint32_t priority = 0)
+    {
+        using Adc = modm::platform::AdcInterrupt1;
+        Adc::attachInterruptHandler(handle_interrupt);
+        ADC1->HTR = threshold;
+        ADC1->LTR = 0;
+        // Watch only the given channel of the regular group
+        ADC1->CR1 = (ADC1->CR1 & ~(ADC_CR1_AWDCH | ADC_CR1_JAWDEN)) | ADC_CR1_AWDSGL | ADC_CR1_AWDEN |
+                    (uint32_t(channel) << ADC_CR1_AWDCH_Pos);
+        Adc::enableInterruptVector(priority);
+        arm();
+    }
+
+    /// @brief Records trips and restores the outputs after the backoff, call regularly from a fiber.
+    /// @return True if a trip was recorded.
+    static bool update()
+    {
+        bool recorded = false;
+        if (tripped.load(std::memory_order_acquire))
+        {
+            recovery_type::event e = last;
+            tripped.store(false, std::memory_order_relaxed);
+            recovery.trip(e);
+            recorded = true;
+        }
+        if (recovery.restart_due(modm::PreciseClock::now()))
+        {
+            restore();
+        }
+        return recorded;
+    }
+
+    /// @brief Ends a lock out and switches the outputs on again.
+    static void reset()
+    {
+        const auto state = recovery.state();
+        recovery.reset(modm::PreciseClock::now());
+        if (state != trip_state::ARMED)
+        {
+            restore();
+        }
+    }
+
+    /// @brief Checks if the outputs are cut.
+    static bool is_tripped() { return tripped.load(std::memory_order_relaxed) or recovery.state() != trip_state::ARMED; }
+
+private:
+    static void arm()
+    {
+        ADC1->SR = ~ADC_SR_AWD;
+        ADC1->CR1 |= ADC_CR1_AWDIE;
+    }
+
+    static void restore()
+    {
+        arm();
+        Timer::enableOutput();
+        if (was_enabled)
+        {
+            Enable::set();
+        }
+    }
+
+    static void handle_interrupt()
+    {
+        const uint32_t entry = DWT->CYCCNT;
+        if (not (ADC1->SR & ADC_SR_AWD))
+        {
+            return;
+        }
+        was_enabled = Enable::isSet();
+        Enable::reset();
+        Timer::disableOutput();
+        const uint32_t cut = DWT->CYCCNT;
+
+        // Stays off until restore(), the current is above the threshold for a while
+        ADC1->CR1 &= ~ADC_CR1_AWDIE;
+        ADC1->SR = ~ADC_SR_AWD;
+
+        // The exception entry takes 12 cycles before the first instruction of the handler
+        const uint64_t cycles = uint64_t(cut - entry) + 12;
+        last.time = modm::PreciseClock::now();
+        last.latency = std::chrono::nanoseconds(cycles * 1'000'000'000 / SystemClock::Frequency);
+        last.value = static_cast<uint16_t>(ADC1->DR);
+        tripped.store(true, std::memory_order_release);
+    }
+
+    /// @brief Written by the interrupt, read by update() once tripped is set.
+    /// @details The release store of tripped keeps the writes of last before it, the acquire load
+    /// in update() keeps the copy after it. A volatile flag orders neither.
+    static inline recovery_type::event last{};
+    static inline std::atomic<bool> tripped{false};
+    static inline bool was_enabled = false;
+};
@@ -0,0 +1,156 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/// @brief A continuous stream of timestamped ADC samples in a ring buffer.
+/// @details One producer, usually the DMA interrupt of adc_dma_sampler, pushes blocks of scans.
+/// Every decimation scans are averaged into one sample. Any number of consumers read the samples
+/// in place, each with its own reader, without locks and without copying. The producer never
+/// waits: a reader which falls more than Depth samples behind loses the oldest ones, which are
+/// counted in reader::dropped. Because the samples are read in place, consume() tells whether
+/// they were overwritten while they were read. Does not depend on modm.
+/// @tparam Channels The number of channels of a scan.
+/// @tparam Depth The number of samples kept, a power of two.
+template <size_t Channels, size_t Depth>
+class sample_stream
+{
+    static_assert(Channels > 0);
+    static_assert(Depth > 0 and (Depth & (Depth - 1)) == 0, "The depth must be a power of two");
+
+public:
+    struct sample
+    {
+        /// @brief The time of the last scan averaged into the sample in µs, wraps after 71 minutes.
+        uint32_t time;
+        std::array<uint16_t, Channels> values;
+    };
+
+    /// @brief The read position of one consumer.
+    struct reader
+    {
+        /// @brief The index of the next sample to read, counting all samples ever pushed.
+        uint32_t position = 0;
+        /// @brief Samples overwritten before this reader consumed them.
+        uint32_t dropped = 0;
+    };
+
+    /// @brief Sets how many scans are averaged into one sample, may be changed at any time.
+    /// @details Takes effect with the next sample, a partly averaged one is discarded.
+    void set_decimation(const uint16_t scans)
+    {
+        decimation.store(scans > 0 ? scans : 1, std::memory_order_relaxed);
+    }
+
+    uint16_t get_decimation() const { return decimation.load(std::memory_order_relaxed); }
+
+    /// @brief The measured time between two scans in µs, zero before the second block.
+    uint32_t scan_period() const { return period_q8 >> 8; }
+
+    /// @brief Appends a block of scans, called by the producer only.
+    /// @param scans count scans of Channels values each, in the order they were converted.
+    /// @param count The number of scans.
+    /// @param end_time The time of the last scan in µs.
+    void push(const uint16_t *scans, const size_t count, const uint32_t end_time)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        // The scans of a block are spread evenly back from its end, at the rate of the last blocks
+        if (last_end_valid)
+        {
+            period_q8 = static_cast<uint32_t>((uint64_t(end_time - last_end) << 8) / count);
+        }
+        last_end = end_time;
+        last_end_valid = true;
+
+        const auto scans_per_sample = decimation.load(std::memory_order_relaxed);
+        if (scans_per_sample != accumulated_decimation)
+        {
+            accumulated = 0;
+            accumulated_decimation = scans_per_sample;
+        }
+        auto position = head.load(std::memory_order_relaxed);
+        for (size_t scan = 0; scan < count; ++scan)
+        {
+            for (size_t channel = 0; channel < Channels; ++channel)
+            {
+                sums[channel] = (accumulated ? sums[channel] : 0) + scans[scan * Channels + channel];
+            }
+            if (++accumulated < scans_per_sample)
+            {
+                continue;
+            }
+            auto &out = samples[position & (Depth - 1)];
+            out.time = end_time - static_cast<uint32_t>((uint64_t(count - 1 - scan) * period_q8) >> 8);
+            for (size_t channel = 0; channel < Channels; ++channel)
+            {
+                out.values[channel] = static_cast<uint16_t>(sums[channel] / scans_per_sample);
+            }
+            accumulated = 0;
+            ++position;
+            // Publish sample by sample, so readers see new samples even during a long block
+            head.store(position, std::memory_order_release);
+        }
+    }
+
+    /// @brief Creates a reader which starts with the next sample pushed.
+    reader subscribe() const { return {.position = head.load(std::memory_order_acquire)}; }
+
+    /// @brief The number of samples pushed so far.
+    uint32_t pushed() const { return head.load(std::memory_order_acquire); }
+
+    /// @brief The samples the reader has not read yet, as far as they are contiguous in the buffer.
+    /// @details Skips the samples the reader lost. The rest follows with the next call after
+    /// consume() if the buffer wraps.
+    /// @return The samples, valid until the producer overwrites them, see consume().
+    std::span<const sample> peek(reader &r) const
+    {
+        const auto position = head.load(std::memory_order_acquire);
+        if (position - r.position >= Depth)
+        {
+            // Leave one sample of headroom, the producer may write the oldest one right now
+            const auto first = position - static_cast<uint32_t>(Depth) + 1;
+            r.dropped += first - r.position;
+            r.position = first;
+        }
+        const auto start = r.position & (Depth - 1);
+        const auto available = position - r.position;
+        const auto contiguous = Depth - start;
+        return {samples.data() + start, available < contiguous ? available : contiguous};
+    }
+
+    /// @brief Marks samples returned by peek() as read.
+    /// @param r The reader.
+    /// @param count The number of samples read, at most as many as peek() returned.
+    /// @return False if some of them were overwritten while they were read, they count as dropped then.
+    bool consume(reader &r, const size_t count) const
+    {
+        r.position += uint32_t(count);
+        const auto position = head.load(std::memory_order_acquire);
+        // The sample at position - Depth may be in the middle of being written
+        if (position - (r.position - uint32_t(count)) >= Depth)
+        {
+            r.dropped += uint32_t(count);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::array<sample, Depth> samples{};
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint16_t> decimation{1};
+
+    // Only used by the producer
+    std::array<uint32_t, Channels> sums{};
+    uint16_t accumulated = 0;
+    uint16_t accumulated_decimation = 1;
+    uint32_t last_end = 0;
+    bool last_end_valid = false;
+    /// @brief µs between two scans in 24.8 fixed point, a single word read atomically by scan_period().
+    uint32_t period_q8 = 0;
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+enum class trip_state : uint8_t
+{
+    /// @brief The outputs are on and the protection watches.
+    ARMED,
+    /// @brief The protection cut the outputs, they are restored after the backoff.
+    TRIPPED,
+    /// @brief Too many trips in a row, the outputs stay off until reset().
+    LOCKED_OUT,
+};
+
+/// @brief Decides when outputs cut by a protection are switched on again.
+/// @details Each trip in a row doubles the wait before the next restart, up to max_backoff.
+/// After max_retries trips in a row the outputs stay off. A restart which then runs for
+/// stable_time without a trip starts a new row. The last trips are kept with their times.
+/// Only decides, the protection cuts and restores the outputs. Does not depend on modm, so any
+/// clock with the interface of std::chrono clocks can be used.
+/// @tparam Clock The clock of the time points.
+/// @tparam History The number of trips kept.
+template <typename Clock, size_t History = 8>
+class trip_recovery
+{
+    static_assert(History > 0);
+
+public:
+    using duration = typename Clock::duration;
+    using time_point = typename Clock::time_point;
+
+    struct event
+    {
+        /// @brief When the protection cut the outputs.
+        time_point time{};
+        /// @brief The time from the interrupt to the cut outputs, without the time until the sample.
+        std::chrono::nanoseconds latency{};
+        /// @brief The measured value which tripped, in ADC counts.
+        uint16_t value = 0;
+        /// @brief The number of the trip in its row, 1 for the first.
+        uint8_t retry = 0;
+    };
+
+    /// @brief The wait before the first restart of a row.
+    duration first_backoff = std::chrono::milliseconds(10);
+
+    /// @brief The longest wait before a restart.
+    duration max_backoff = std::chrono::seconds(2);
+
+    /// @brief The trips in a row after which the outputs stay off.
+    uint8_t max_retries = 5;
+
+    /// @brief The time the outputs have to stay on after a restart to end a row of trips.
+    duration stable_time = std::chrono::seconds(1);
+
+    constexpr trip_state state() const { return current; }
+
+    /// @brief Records a trip, the outputs must be off already.
+    constexpr void trip(event e)
+    {
+        if (current == trip_state::LOCKED_OUT)
+        {
+            return;
+        }
+        if (current == trip_state::ARMED and e.time - armed_since >= stable_time)
+        {
+            consecutive = 0;
+        }
+        ++consecutive;
+        e.retry = static_cast<uint8_t>(consecutive < UINT8_MAX ? consecutive : UINT8_MAX);
+        events[total % History] = e;
+        ++total;
+        if (e.latency > worst)
+        {
+            worst = e.latency;
+        }
+
+        if (consecutive > max_retries)
+        {
+            current = trip_state::LOCKED_OUT;
+            return;
+        }
+        auto backoff = first_backoff;
+        for (uint32_t i = 1; i < consecutive and backoff < max_backoff; ++i)
+        {
+            backoff *= 2;
+        }
+        restart_at = e.time + (backoff < max_backoff ? backoff : max_backoff);
+        current = trip_state::TRIPPED;
+    }
+
+    /// @brief Checks if the outputs are to be restored now, which arms the protection again.
+    constexpr bool restart_due(const time_point now)
+    {
+        if (current != trip_state::TRIPPED or now < restart_at)
+        {
+            return false;
+        }
+        current = trip_state::ARMED;
+        armed_since = now;
+        return true;
+    }
+
+    /// @brief The time of the next restart, valid while TRIPPED.
+    constexpr time_point next_restart() const { return restart_at; }
+
+    /// @brief Ends a lock out or a row of trips, e.g. after the short circuit was removed.
+    /// @details The protection has to restore the outputs if the state was not ARMED.
+    constexpr void reset(const time_point now)
+    {
+        current = trip_state::ARMED;
+        consecutive = 0;
+        armed_since = now;
+    }
+
+    /// @brief The number of trips so far.
+    constexpr uint32_t trips() const { return total; }
+
+    /// @brief The trips in the current row.
+    constexpr uint32_t retries() const { return consecutive; }
+
+    /// @brief The longest latency of all trips.
+    constexpr std::chrono::nanoseconds worst_latency() const { return worst; }
+
+    /// @brief A recorded trip.
+    /// @param age 0 for the last trip, up to History - 1 and below trips().
+    constexpr const event &recent(const size_t age) const
+    {
+        return events[(total - 1 - age) % History];
+    }
+
+private:
+    trip_state current = trip_state::ARMED;
+    uint32_t consecutive = 0;
+    uint32_t total = 0;
+    time_point armed_since{};
+    time_point restart_at{};
+    std::chrono::nanoseconds worst{};
+    std::array<event, History> events{};
+};
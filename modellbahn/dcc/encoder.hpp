@@ -0,0 +1,159 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/// @brief The durations of the half bits of the track signal in µs, see NMRA S-9.1.
+/// @details A bit is two half bits of opposite polarity with the same duration. A command
+/// station sends 55 to 61 µs for a one and 95 to 9900 µs for a zero.
+struct dcc_timing
+{
+    uint16_t one = 58;
+    uint16_t zero = 100;
+};
+
+/// @brief A DCC packet without its error detection byte, see NMRA S-9.2.
+struct dcc_packet
+{
+    /// @brief The longest packet has six bytes including the error detection byte.
+    static constexpr size_t max_bytes = 5;
+
+    /// @brief The highest address of the long form, short addresses are 1 to 127.
+    static constexpr uint16_t max_address = 10239;
+
+    std::array<uint8_t, max_bytes> bytes{};
+    uint8_t length = 0;
+
+    /// @brief The packet sent when nothing else is to be sent.
+    static constexpr dcc_packet idle() { return {{0xff, 0x00}, 2}; }
+
+    /// @brief Stops all decoders and clears their volatile state.
+    static constexpr dcc_packet reset() { return {{0x00, 0x00}, 2}; }
+
+    /// @brief Speed and direction with 128 speed steps.
+    /// @param address The address of the locomotive, 1 to max_address.
+    /// @param forward The direction.
+    /// @param step The speed step, 0 stops and 1 to 126 run.
+    /// @return An empty packet if the address or the step is out of range.
+    static constexpr dcc_packet speed(const uint16_t address, const bool forward, const uint8_t step)
+    {
+        auto packet = addressed(address);
+        if (packet.length == 0 or step > 126)
+        {
+            return {};
+        }
+        // Step 1 of the instruction is the emergency stop
+        packet.append(0x3f);
+        packet.append(static_cast<uint8_t>((forward ? 0x80 : 0x00) | (step ? step + 1 : 0)));
+        return packet;
+    }
+
+    /// @brief Stops a locomotive at once, without its deceleration.
+    /// @return An empty packet if the address is out of range.
+    static constexpr dcc_packet emergency_stop(const uint16_t address, const bool forward)
+    {
+        auto packet = addressed(address);
+        if (packet.length == 0)
+        {
+            return {};
+        }
+        packet.append(0x3f);
+        packet.append(forward ? 0x81 : 0x01);
+        return packet;
+    }
+
+    /// @brief The error detection byte, the XOR of all bytes.
+    constexpr uint8_t checksum() const
+    {
+        uint8_t result = 0;
+        for (size_t i = 0; i < length; ++i)
+        {
+            result ^= bytes[i];
+        }
+        return result;
+    }
+
+    constexpr bool operator==(const dcc_packet &) const = default;
+
+private:
+    static constexpr dcc_packet addressed(const uint16_t address)
+    {
+        dcc_packet packet;
+        if (address == 0 or address > max_address)
+        {
+            return packet;
+        }
+        if (address > 127)
+        {
+            packet.append(static_cast<uint8_t>(0xc0 | (address >> 8)));
+        }
+        packet.append(static_cast<uint8_t>(address & 0xff));
+        return packet;
+    }
+
+    constexpr void append(const uint8_t value) { bytes[length++] = value; }
+};
+
+/// @brief The fewest preamble bits a command station sends.
+inline constexpr size_t dcc_min_preamble = 14;
+
+/// @brief The number of half bits dcc_encode() writes for a packet.
+constexpr size_t dcc_encoded_size(const dcc_packet &packet, const size_t preamble = 16)
+{
+    // Preamble, a start bit and eight bits per byte and the error detection byte, the end bit
+    return 2 * (preamble + 9 * (packet.length + 1u) + 1);
+}
+
+/// @brief The number of half bits of the longest packet.
+constexpr size_t dcc_max_encoded_size(const size_t preamble = 16)
+{
+    return dcc_encoded_size({.length = dcc_packet::max_bytes}, preamble);
+}
+
+/// @brief Encodes a packet into the durations of its half bits.
+/// @details Writes the preamble of ones, then every byte and the error detection byte after a
+/// zero start bit with the most significant bit first, and the end bit. Each bit becomes two
+/// equal half bits. Depends on nothing but the packet, so the output can be compared with the
+/// bit streams of the standard on the host, see tools/dcccheck.cpp.
+/// @param packet A packet of 2 to max_bytes bytes.
+/// @param half_bits At least dcc_encoded_size() durations.
+/// @param preamble The number of preamble bits, at least dcc_min_preamble.
+/// @param timing The durations of the half bits.
+/// @return The number of durations written, 0 if the packet or the preamble is invalid or the
+/// output too small.
+constexpr size_t dcc_encode(const dcc_packet &packet, const std::span<uint16_t> half_bits,
+                            const size_t preamble = 16, const dcc_timing &timing = {})
+{
+    if (packet.length < 2 or packet.length > dcc_packet::max_bytes or preamble < dcc_min_preamble or
+        half_bits.size() < dcc_encoded_size(packet, preamble))
+    {
+        return 0;
+    }
+    size_t position = 0;
+    const auto put = [&](const bool bit)
+    {
+        half_bits[position++] = bit ? timing.one : timing.zero;
+        half_bits[position++] = bit ? timing.one : timing.zero;
+    };
+    const auto put_byte = [&](const uint8_t value)
+    {
+        put(false);
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            put((value >> bit) & 1);
+        }
+    };
+
+    for (size_t i = 0; i < preamble; ++i)
+    {
+        put(true);
+    }
+    for (size_t i = 0; i < packet.length; ++i)
+    {
+        put_byte(packet.bytes[i]);
+    }
+    put_byte(packet.checksum());
+    put(true);
+    return position;
+}
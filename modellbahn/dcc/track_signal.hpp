@@ -0,0 +1,216 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <modm/platform.hpp>
+#include "encoder.hpp"
+
+/// @brief Generates the DCC track signal with Timer1, streaming the timing of every bit by DMA.
+/// @details Every bit is one period of the timer counting up in µs. The output in the first half
+/// bit is channel 3 in PWM mode 1, high until the compare value, and the output in the second
+/// half bit is channel 1 in PWM mode 2, high from the same compare value on, so the H-bridge
+/// reverses the polarity of the track in the middle of each bit. At every update event the DMA
+/// writes the auto-reload and compare values of one bit with a burst into the preload registers,
+/// which take effect with the next update, so the edges are exact and the CPU does nothing per
+/// bit. The DMA buffer has two halves, whenever one was sent its interrupt refills it with the
+/// following bits from the packet queue, or with idle packets if the queue is empty. Channel 2
+/// rises in the middle of the first half bit to start the ADC scans, see adc_dma_sampler. The
+/// board sets up the timer mode and the output channels before initialize().
+/// @tparam Dma The DMA channel mapped to the update event of Timer1, e.g. Dma2::Channel5.
+/// @tparam Queue The number of packets waiting to be sent, a power of two.
+/// @tparam Preamble The number of preamble bits of every packet.
+template <typename Dma, size_t Queue = 8, size_t Preamble = 16>
+class track_signal
+{
+    static_assert(Queue > 0 and (Queue & (Queue - 1)) == 0, "The queue size must be a power of two");
+    static_assert(Preamble >= dcc_min_preamble, "Decoders need at least 14 preamble bits");
+
+public:
+    using Timer = modm::platform::Timer1;
+
+    /// @brief The registers of one bit in the order of the burst, ARR to CCR3.
+    struct bit_registers
+    {
+        uint16_t reload;
+        uint16_t repetition;
+        uint16_t compare1;
+        uint16_t compare2;
+        uint16_t compare3;
+    };
+
+    /// @brief The number of bits in one half of the DMA buffer.
+    static constexpr size_t half_size = 16;
+
+    static constexpr size_t burst_length = sizeof(bit_registers) / sizeof(uint16_t);
+
+    /// @brief The timing of the bits, may be changed before initialize().
+    static inline dcc_timing timing{};
+
+    /// @brief Starts the signal with idle packets.
+    /// @details Call after the Dma controller was enabled.
+    /// @param trigger_lead The µs the ADC trigger comes before the middle of the first half bit,
+    /// half the sample time centers the sample.
+    /// @param priority The priority of the DMA interrupt.
+    template <typename SystemClock>
+    static void initialize(const uint16_t trigger_lead, const uint32_t priority = 6)
+    {
+        lead = trigger_lead;
+        Timer::setPrescaler(static_cast<uint16_t>(SystemClock::Timer1 / 1'000'000));
+
+        // The preamble starts with a one until the first bit from the DMA takes effect
+        const auto first = to_registers(timing.one, timing.one);
+        TIM1->ARR = first.reload;
+        TIM1->RCR = first.repetition;
+        TIM1->CCR1 = first.compare1;
+        TIM1->CCR2 = first.compare2;
+        TIM1->CCR3 = first.compare3;
+        Timer::applyAndReset();
+
+        // A burst writes burst_length registers from ARR on through DMAR at every update
+        const auto base = static_cast<uint32_t>((uintptr_t(&TIM1->ARR) - uintptr_t(TIM1)) / sizeof(uint32_t));
+        TIM1->DCR = ((burst_length - 1) << TIM_DCR_DBL_Pos) | (base << TIM_DCR_DBA_Pos);
+
+        Dma::configure(Dma::DataTransferDirection::MemoryToPeripheral, Dma::MemoryDataSize::HalfWord,
+                       Dma::PeripheralDataSize::HalfWord, Dma::MemoryIncrementMode::Increment,
+                       Dma::PeripheralIncrementMode::Fixed, Dma::Priority::VeryHigh, Dma::CircularMode::Enabled);
+        Dma::template setPeripheralRequest<Dma::template RequestMapping<modm::platform::Peripheral::Tim1,
+                                                                        modm::platform::DmaBase::Signal::Up>::Request>();
+        Dma::setPeripheralAddress(uintptr_t(&TIM1->DMAR));
+        Dma::setHalfTransferCompleteIrqHandler(handle_half_transfer);
+        Dma::setTransferCompleteIrqHandler(handle_transfer_complete);
+        Dma::setTransferErrorIrqHandler(handle_error);
+        Dma::enableInterrupt(Dma::InterruptEnable::HalfTransfer | Dma::InterruptEnable::TransferComplete |
+                             Dma::InterruptEnable::TransferError);
+        Dma::enableInterruptVector(priority);
+
+        start();
+        Timer::enableDmaRequest(Timer::DmaRequestEnable::Update);
+        Timer::start();
+    }
+
+    /// @brief Queues a packet, sent once after the packets queued before.
+    /// @details Decoders take a packet only if it arrived intact, so commands should be repeated.
+    /// Call from fibers only.
+    /// @return False if the packet is invalid or the queue is full.
+    static bool send(const dcc_packet &packet)
+    {
+        if (packet.length < 2 or packet.length > dcc_packet::max_bytes)
+        {
+            return false;
+        }
+        const auto position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) >= Queue)
+        {
+            return false;
+        }
+        queue[position & (Queue - 1)] = packet;
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief The number of packets which may still be queued.
+    static size_t space()
+    {
+        return Queue - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+    }
+
+    /// @brief Packets taken from the queue so far.
+    static uint32_t sent() { return sent_count; }
+
+    /// @brief Idle packets sent because the queue was empty.
+    static uint32_t idles() { return idle_count; }
+
+    /// @brief Number of times the DMA stopped with an error and the stream was restarted.
+    static uint32_t errors() { return error_count; }
+
+    /// @brief The registers of a bit made of two half bits.
+    /// @param first The duration of the first half bit in µs.
+    /// @param second The duration of the second half bit in µs.
+    static constexpr bit_registers to_registers(const uint16_t first, const uint16_t second)
+    {
+        // Pwm mode 2 never rises with a compare value of zero
+        const auto middle = first / 2;
+        return {
+            .reload = static_cast<uint16_t>(first + second - 1),
+            .repetition = 0,
+            .compare1 = first,
+            .compare2 = static_cast<uint16_t>(middle > lead ? middle - lead : 1),
+            .compare3 = first,
+        };
+    }
+
+private:
+    /// @brief Restarts the DMA at the beginning of a refilled buffer.
+    static void start()
+    {
+        Dma::stop();
+        fill(buffer.data());
+        fill(buffer.data() + half_size);
+        Dma::setMemoryAddress(uintptr_t(buffer.data()));
+        Dma::setDataLength(buffer.size() * burst_length);
+        Dma::start();
+    }
+
+    /// @brief Writes the next half_size bits.
+    static void fill(bit_registers *bits)
+    {
+        for (size_t i = 0; i < half_size; ++i)
+        {
+            if (position >= encoded)
+            {
+                next_packet();
+            }
+            bits[i] = to_registers(half_bits[position], half_bits[position + 1]);
+            position += 2;
+        }
+    }
+
+    static void next_packet()
+    {
+        auto packet = dcc_packet::idle();
+        const auto next = tail.load(std::memory_order_relaxed);
+        if (next != head.load(std::memory_order_acquire))
+        {
+            packet = queue[next & (Queue - 1)];
+            tail.store(next + 1, std::memory_order_release);
+            ++sent_count;
+        }
+        else
+        {
+            ++idle_count;
+        }
+        encoded = dcc_encode(packet, half_bits, Preamble, timing);
+        if (encoded == 0)
+        {
+            encoded = dcc_encode(dcc_packet::idle(), half_bits, Preamble, timing);
+        }
+        position = 0;
+    }
+
+    static void handle_half_transfer() { fill(buffer.data()); }
+
+    static void handle_transfer_complete() { fill(buffer.data() + half_size); }
+
+    static void handle_error()
+    {
+        // The timer repeats the last bit meanwhile
+        ++error_count;
+        start();
+    }
+
+    alignas(uint32_t) static inline std::array<bit_registers, 2 * half_size> buffer{};
+    static inline std::array<uint16_t, dcc_max_encoded_size(Preamble)> half_bits{};
+    static inline size_t encoded = 0;
+    static inline size_t position = 0;
+    static inline uint16_t lead = 0;
+
+    static inline std::array<dcc_packet, Queue> queue{};
+    /// @brief Packets queued and taken so far, written by send() and the DMA interrupt.
+    static inline std::atomic<uint32_t> head{0};
+    static inline std::atomic<uint32_t> tail{0};
+
+    static inline uint32_t sent_count = 0;
+    static inline uint32_t idle_count = 0;
+    static inline uint32_t error_count = 0;
+};
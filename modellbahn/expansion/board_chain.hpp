@@ -0,0 +1,186 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include "ioposition.hpp"
+
+/// @brief Sizes of a board of the expansion chain in bytes.
+struct board
+{
+    const size_t inputs;
+    const size_t outputs;
+    constexpr size_t buffer_size() const
+    {
+        return std::max(inputs, outputs);
+    }
+};
+
+/// @brief A board type, declaring its number of input and output bytes.
+template <typename T>
+concept board_type = requires {
+    { T::inputs } -> std::convertible_to<size_t>;
+    { T::outputs } -> std::convertible_to<size_t>;
+};
+
+/// @brief Location of an output bit in a controller buffer, resolved from an ioposition.
+struct output_bit
+{
+    /// @brief Index of the byte in the buffer.
+    uint16_t index;
+
+    /// @brief Mask of the bit within the byte.
+    uint8_t mask;
+
+    /// @brief The chain the buffer belongs to.
+    uint8_t chain;
+};
+
+/// @brief Location of an input bit in a controller buffer, same layout as the outputs.
+using input_bit = output_bit;
+
+/// @brief A chain of shift register boards on one SPI, described by the types of its boards.
+/// @details The board nearest to the controller comes first. Every board takes as many bytes of
+/// the frame as its larger side, and the bytes for the last board are sent first. All offsets
+/// and masks are computed at compile time.
+template <board_type... Boards>
+struct board_chain
+{
+    static constexpr size_t board_count = sizeof...(Boards);
+
+    /// @brief Whether the end of the chain is wired back to MISO, see looped_back.
+    static constexpr bool loopback = false;
+
+    /// @brief The sizes of the boards.
+    static constexpr std::array<board, board_count> boards = {board{Boards::inputs, Boards::outputs}...};
+
+    /// @brief The size of a frame of the chain.
+    static constexpr size_t buffer_size = (board{Boards::inputs, Boards::outputs}.buffer_size() + ... + 0);
+
+private:
+    /// @brief The offset of each board in the frame, the last board comes first.
+    static constexpr std::array<size_t, board_count> make_offsets()
+    {
+        std::array<size_t, board_count> result{};
+        size_t offset = 0;
+        for (size_t i = board_count; i-- > 0;)
+        {
+            result[i] = offset;
+            offset += boards[i].buffer_size();
+        }
+        return result;
+    }
+
+    /// @brief Marks the bytes of a side of every board.
+    template <typename Side>
+    static constexpr std::array<uint8_t, buffer_size> make_mask(Side side)
+    {
+        std::array<uint8_t, buffer_size> mask{};
+        const auto offsets = make_offsets();
+        for (size_t i = 0; i < board_count; ++i)
+        {
+            for (size_t byte = 0; byte < side(boards[i]); ++byte)
+            {
+                mask[offsets[i] + byte] = 0xff;
+            }
+        }
+        return mask;
+    }
+
+public:
+    /// @brief The offset of the bytes of each board in the frame.
+    static constexpr std::array<size_t, board_count> offsets = make_offsets();
+
+    /// @brief The output bits of each frame byte, zero for bytes only used by inputs.
+    static constexpr std::array<uint8_t, buffer_size> output_mask = make_mask([](const board &b)
+                                                                              { return b.outputs; });
+
+    /// @brief The input bits of each frame byte, zero for bytes only used by outputs.
+    static constexpr std::array<uint8_t, buffer_size> input_mask = make_mask([](const board &b)
+                                                                             { return b.inputs; });
+
+    /// @brief Checks if an ioposition addresses an existing output of the chain.
+    static constexpr bool is_valid_output(const ioposition &pos)
+    {
+        return pos.board < board_count and pos.bit_pos / 8 < boards[pos.board].outputs;
+    }
+
+    /// @brief Checks if an ioposition addresses an existing input of the chain.
+    static constexpr bool is_valid_input(const ioposition &pos)
+    {
+        return pos.board < board_count and pos.bit_pos / 8 < boards[pos.board].inputs;
+    }
+
+    /// @brief Resolves an ioposition of the chain into its byte index and mask.
+    static constexpr output_bit resolve(const ioposition &pos)
+    {
+        return {
+            .index = static_cast<uint16_t>(offsets[pos.board] + pos.bit_pos / 8),
+            .mask = static_cast<uint8_t>(1 << (pos.bit_pos % 8)),
+            .chain = pos.chain,
+        };
+    }
+};
+
+/// @brief A chain whose last board shifts its register back to MISO.
+/// @details Only such a chain returns the pattern of loopback_check after its length, so the
+/// check is an opt-in per chain, see "loopback" in tools/layoutgen.py. A chain without it
+/// sends its outputs only and takes over its inputs unchecked.
+/// @tparam Chain A board_chain.
+template <typename Chain>
+struct looped_back : Chain
+{
+    static constexpr bool loopback = true;
+};
+
+/// @brief All chains of the expansion, each on its own SPI and chip select.
+/// @details An ioposition selects its chain with ioposition::chain, the index into Chains.
+template <typename... Chains>
+struct chain_set
+{
+    static constexpr size_t count = sizeof...(Chains);
+
+    template <size_t I>
+    using chain = std::tuple_element_t<I, std::tuple<Chains...>>;
+
+    /// @brief The sum of the frame sizes of all chains.
+    static constexpr size_t total_buffer_size = (Chains::buffer_size + ... + 0);
+
+    /// @brief The frame size of every chain, in the order of Chains.
+    static constexpr std::array<size_t, count> buffer_sizes = {Chains::buffer_size...};
+
+    /// @brief The largest frame size of all chains.
+    static constexpr size_t max_buffer_size = std::max({size_t(0), Chains::buffer_size...});
+
+    static constexpr bool is_valid_output(const ioposition &pos)
+    {
+        return visit(pos, [&]<typename Chain>() { return Chain::is_valid_output(pos); });
+    }
+
+    static constexpr bool is_valid_input(const ioposition &pos)
+    {
+        return visit(pos, [&]<typename Chain>() { return Chain::is_valid_input(pos); });
+    }
+
+    static constexpr output_bit resolve(const ioposition &pos)
+    {
+        output_bit bit{};
+        visit(pos, [&]<typename Chain>()
+              { bit = Chain::resolve(pos); return true; });
+        return bit;
+    }
+
+private:
+    /// @brief Calls function for the chain of an ioposition.
+    /// @return The result of the function, false if the chain does not exist.
+    template <typename Function>
+    static constexpr bool visit(const ioposition &pos, Function &&function)
+    {
+        bool result = false;
+        size_t i = 0;
+        ((i++ == pos.chain ? (result = function.template operator()<Chains>(), true) : false) or ...);
+        return result;
+    }
+};
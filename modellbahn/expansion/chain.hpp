@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "board_chain.hpp"
+#include "expansion/chain_config.hpp"
+#include "ioposition.hpp"
+
+/// @brief Checks if an ioposition addresses an existing output of its chain.
+static constexpr bool is_valid_output(const ioposition &pos)
+{
+    return expansion_chains::is_valid_output(pos);
+}
+
+/// @brief Resolves an ioposition into its chain, byte index and mask.
+/// @details Meant to be evaluated at compile time, check the position with is_valid_output().
+static constexpr output_bit resolve_output(const ioposition &pos)
+{
+    return expansion_chains::resolve(pos);
+}
+
+/// @brief Checks if an ioposition addresses an existing input of its chain.
+static constexpr bool is_valid_input(const ioposition &pos)
+{
+    return expansion_chains::is_valid_input(pos);
+}
+
+/// @brief Resolves an ioposition into the chain, byte index and mask of the received buffer.
+/// @details The boards shift their inputs out in the same order they receive their outputs, so
+/// the offsets are the same, check the position with is_valid_input().
+static constexpr input_bit resolve_input(const ioposition &pos)
+{
+    return resolve_output(pos);
+}
+
+/// @brief Word-wide set and clear masks for many outputs of a buffer at once.
+/// @tparam Bytes The size of the buffer.
+template <size_t Bytes>
+struct output_mask
+{
+    static constexpr size_t words = (Bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    /// @brief Bits to set, in the byte order of the buffer.
+    std::array<uint32_t, words> set{};
+
+    /// @brief Bits to clear, in the byte order of the buffer.
+    std::array<uint32_t, words> clear{};
+
+    /// @brief Adds an output to the masks.
+    /// @param bit The output.
+    /// @param state The state the output shall get.
+    constexpr void assign(const output_bit &bit, const bool state)
+    {
+        const auto word = bit.index / sizeof(uint32_t);
+        const auto shift = (bit.index % sizeof(uint32_t)) * 8;
+        const auto mask = uint32_t(bit.mask) << shift;
+        if (state)
+        {
+            set[word] |= mask;
+            clear[word] &= ~mask;
+        }
+        else
+        {
+            clear[word] |= mask;
+            set[word] &= ~mask;
+        }
+    }
+
+    /// @brief Applies the masks to a buffer, one word at a time.
+    /// @param buffer The buffer, which must be at least words * 4 bytes long.
+    /// @return True if any output changed.
+    bool apply(uint8_t *buffer) const
+    {
+        uint32_t changed = 0;
+        for (size_t i = 0; i < words; ++i)
+        {
+            uint32_t value;
+            std::memcpy(&value, buffer + i * sizeof(uint32_t), sizeof(value));
+            const auto next = (value & ~clear[i]) | set[i];
+            changed |= next ^ value;
+            std::memcpy(buffer + i * sizeof(uint32_t), &next, sizeof(next));
+        }
+        return changed != 0;
+    }
+};
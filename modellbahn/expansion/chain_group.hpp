@@ -0,0 +1,193 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include "chain_io.hpp"
+#include "ioposition.hpp"
+
+/// @brief All chains of the expansion, each on its own transport, latched together.
+/// @details refresh() starts the transfers of all chains before it waits for the first one, so a
+/// refresh takes as long as the longest chain instead of the sum of all chains. The latch is
+/// shared by all chains and only rises after every transfer completed, so the outputs of all
+/// chains change with the same edge. The transfers of looped_back chains carry a loopback
+/// pattern, see loopback_check, and a chain whose check keeps failing is reported by
+/// take_faults(). Does not depend on modm, see controller for the fiber.
+/// @tparam Latch Latches all chains on its rising edge, with reset() and set().
+/// @tparam Transports One transport per chain of expansion_chains, in the same order, with
+/// start(tx, rx, length) and wait(), see spi_dma_transport.
+template <typename Latch, typename... Transports>
+class chain_group
+{
+public:
+    static constexpr size_t count = sizeof...(Transports);
+
+    static_assert(count == expansion_chains::count, "Every chain of the expansion needs a transport");
+    static_assert(count > 0 and count <= 32, "The failed chains of refresh() are a 32 bit mask");
+
+    template <size_t I>
+    using transport = std::tuple_element_t<I, std::tuple<Transports...>>;
+
+    /// @brief The buffers of a chain.
+    template <size_t I>
+    chain_io<I> &chain() { return std::get<I>(chains); }
+
+    template <size_t I>
+    const chain_io<I> &chain() const { return std::get<I>(chains); }
+
+    /// @brief Sets an output resolved at compile time, only checking its chain.
+    /// @param bit The output, see resolve_output().
+    /// @param state The state of the output.
+    void set_output(const output_bit &bit, bool state)
+    {
+        visit(bit.chain, [&](auto &io)
+              { io.set_output(bit, state); });
+    }
+
+    /// @brief Reads an input resolved at compile time, only checking its chain.
+    /// @param bit The input, see resolve_input().
+    /// @return The state of the input, false if its chain does not exist.
+    bool get_input(const input_bit &bit) const
+    {
+        bool state = false;
+        visit(bit.chain, [&](const auto &io)
+              { state = io.get_input(bit); });
+        return state;
+    }
+
+    /// @brief Reads an input, checked and resolved at compile time.
+    template <ioposition Pos>
+    bool get_input() const
+    {
+        static_assert(Pos.chain < count, "The chain of the input does not exist");
+        return chain<Pos.chain>().template get_input<Pos>();
+    }
+
+    /// @brief Checks if the outputs of any chain changed since the last publish().
+    bool is_modified() const
+    {
+        return std::apply([](const auto &...io)
+                          { return (io.out_buffer.is_modified() or ...); },
+                          chains);
+    }
+
+    /// @brief Publishes the outputs of all chains, must not be called while a refresh runs.
+    /// @return The number of writes published, see double_buffer::publish().
+    uint32_t publish()
+    {
+        return std::apply([](auto &...io)
+                          { return (io.out_buffer.publish() + ... + 0u); },
+                          chains);
+    }
+
+    /// @brief The result of the integrity checks of a chain.
+    /// @param index The index of the chain, which must exist.
+    const integrity_report &integrity(const size_t index) const
+    {
+        const integrity_report *report = nullptr;
+        visit(index, [&](const auto &io)
+              { report = &io.integrity(); });
+        return *report;
+    }
+
+    /// @brief Clears the fault of a chain after it was repaired.
+    void clear_fault(const size_t index)
+    {
+        visit(index, [](auto &io)
+              { io.loopback.clear_fault(); });
+        faulted &= ~(1u << index);
+        reported &= ~(1u << index);
+    }
+
+    /// @brief The chains which became faulty since the last call, bit I for chain I.
+    uint32_t take_faults()
+    {
+        const auto faults = faulted & ~reported;
+        reported |= faults;
+        return faults;
+    }
+
+    /// @brief Refreshes all chains at the same time and latches them together.
+    /// @return A mask of the chains whose transfer failed, bit I for chain I.
+    uint32_t refresh()
+    {
+        prepare();
+        begin_transfers();
+        const auto failed = finish_transfers();
+        Latch::set();
+        return failed;
+    }
+
+    /// @brief Puts the loopback patterns in front of the published outputs.
+    void prepare()
+    {
+        [this]<size_t... I>(std::index_sequence<I...>)
+        { (chain<I>().prepare(), ...); }(std::index_sequence_for<Transports...>{});
+    }
+
+    /// @brief Lowers the latch and starts the transfers of all chains, may be called from an interrupt.
+    void begin_transfers()
+    {
+        [this]<size_t... I>(std::index_sequence<I...>)
+        {
+            Latch::reset();
+            (transport<I>::start(chain<I>().transmit(), chain<I>().receive(), chain_io<I>::frame_size), ...);
+        }(std::index_sequence_for<Transports...>{});
+    }
+
+    /// @brief Waits for the transfers of all chains and takes over their inputs, without latching.
+    /// @return A mask of the chains whose transfer failed, bit I for chain I.
+    uint32_t finish_transfers()
+    {
+        return [this]<size_t... I>(std::index_sequence<I...>)
+        {
+            uint32_t failed = 0;
+            (complete<I>(failed), ...);
+            return failed;
+        }(std::index_sequence_for<Transports...>{});
+    }
+
+private:
+    template <size_t... I>
+    static std::tuple<chain_io<I>...> make_chains(std::index_sequence<I...>);
+
+    using chains_type = decltype(make_chains(std::index_sequence_for<Transports...>{}));
+
+    /// @brief Waits for the transfer of chain I, checks it and takes over its inputs.
+    template <size_t I>
+    void complete(uint32_t &failed)
+    {
+        if (transport<I>::wait())
+        {
+            if (not chain<I>().complete() and chain<I>().integrity().fault)
+            {
+                faulted |= 1u << I;
+            }
+        }
+        else
+        {
+            failed |= 1u << I;
+        }
+    }
+
+    /// @brief Calls function with the buffers of a chain, does nothing if it does not exist.
+    template <typename Function>
+    void visit(const size_t index, Function &&function)
+    {
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { ((index == I ? (function(chain<I>()), true) : false) or ...); }(std::index_sequence_for<Transports...>{});
+    }
+
+    template <typename Function>
+    void visit(const size_t index, Function &&function) const
+    {
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { ((index == I ? (function(chain<I>()), true) : false) or ...); }(std::index_sequence_for<Transports...>{});
+    }
+
+    chains_type chains;
+
+    /// @brief Chains with a fault, and those of them take_faults() returned already.
+    uint32_t faulted = 0;
+    uint32_t reported = 0;
+};
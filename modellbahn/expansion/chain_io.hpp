@@ -0,0 +1,137 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "chain.hpp"
+#include "debouncer.hpp"
+#include "double_buffer.hpp"
+#include "ioposition.hpp"
+#include "loopback_check.hpp"
+
+/// @brief The buffers of one chain of the expansion.
+/// @details Outputs are written to the back buffer of a double_buffer. publish() hands them to
+/// the next transfer. prepare() puts the loopback pattern in front of them, the transfer sends
+/// transmit() and receives into receive(), and complete() checks the returned pattern and takes
+/// over the received inputs. Chains which are not looped_back send no pattern and take over
+/// every complete transfer. Does not depend on modm, see chain_group for the transfers.
+/// @tparam Chain The index of the chain in expansion_chains.
+template <size_t Chain>
+class chain_io
+{
+public:
+    using chain_type = typename expansion_chains::template chain<Chain>;
+
+    static constexpr size_t index = Chain;
+    static constexpr size_t buffer_size = chain_type::buffer_size;
+
+    /// @brief Whether every transfer is checked with a loopback pattern, see looped_back.
+    static constexpr bool checked = chain_type::loopback;
+
+    /// @brief The size of the pattern sent in front of the outputs, zero without the check.
+    static constexpr size_t pattern_size = checked ? loopback_check<buffer_size>::pattern_size : 0;
+
+    /// @brief The size of a transfer, the loopback pattern followed by the outputs.
+    static constexpr size_t frame_size = pattern_size + buffer_size;
+
+    using mask_type = output_mask<buffer_size>;
+
+    /// @brief Output buffers, padded to whole words for apply(). Only frame_size bytes are sent.
+    double_buffer<buffer_size, pattern_size> out_buffer;
+
+    /// @brief Inputs received with the last complete refresh, stable between refreshes.
+    /// @details The boards load their inputs when the latch falls and shift them out while the
+    /// outputs are shifted in, so inputs are sampled with every refresh.
+    alignas(uint32_t) std::array<uint8_t, buffer_size> in_buffer = {0};
+
+    /// @brief The inputs debounced over the last refreshes, see debouncer::set_samples().
+    debouncer<buffer_size> debounced_inputs;
+
+    /// @brief Checks the chain with every transfer if it is checked, see loopback_check.
+    loopback_check<buffer_size> loopback;
+
+    /// @brief Number of refreshes which updated in_buffer.
+    uint32_t input_frames() const { return frames; }
+
+    /// @brief The result of the integrity checks of the chain.
+    const integrity_report &integrity() const { return loopback.report(); }
+
+    /// @brief Reads an input resolved at compile time, without any checks.
+    /// @param bit The input, see resolve_input().
+    bool get_input(const input_bit &bit) const
+    {
+        return in_buffer[bit.index] & bit.mask;
+    }
+
+    /// @brief Reads an input, checked and resolved at compile time.
+    template <ioposition Pos>
+    bool get_input() const
+    {
+        static_assert(Pos.chain == Chain, "The input belongs to another chain");
+        static_assert(chain_type::is_valid_input(Pos), "The input does not exist in the expansion chain");
+        constexpr auto bit = chain_type::resolve(Pos);
+        return in_buffer[bit.index] & bit.mask;
+    }
+
+    /// @brief Sets an output resolved at compile time, without any checks.
+    /// @param bit The output, see resolve_output().
+    /// @param state The state of the output.
+    void set_output(const output_bit &bit, bool state)
+    {
+        auto &byte = out_buffer.back()[bit.index];
+        const auto value = static_cast<uint8_t>((byte & ~bit.mask) | (state ? bit.mask : 0));
+        if (value != byte)
+        {
+            byte = value;
+            out_buffer.touch();
+        }
+    }
+
+    /// @brief Sets and clears many outputs at once.
+    /// @param mask The outputs to set and clear.
+    void apply(const mask_type &mask)
+    {
+        if (mask.apply(out_buffer.back()))
+        {
+            out_buffer.touch();
+        }
+    }
+
+    /// @brief Puts the next loopback pattern in front of the published outputs.
+    void prepare()
+    {
+        if constexpr (checked)
+        {
+            loopback.fill(out_buffer.prefix());
+        }
+    }
+
+    /// @brief The frame to send, stable until the next publish().
+    const uint8_t *transmit() const { return out_buffer.front(); }
+
+    /// @brief The buffer the transfer receives into.
+    uint8_t *receive() { return receive_buffer.data(); }
+
+    /// @brief Checks the returned pattern of a complete transfer and takes over its inputs.
+    /// @return False if the pattern did not return, the inputs are kept then.
+    bool complete()
+    {
+        if constexpr (checked)
+        {
+            if (not loopback.verify(receive_buffer.data()))
+            {
+                return false;
+            }
+        }
+        // Copied only after a complete transfer, readers never see a partial frame
+        std::memcpy(in_buffer.data(), receive_buffer.data(), buffer_size);
+        debounced_inputs.update(in_buffer.data());
+        ++frames;
+        return true;
+    }
+
+private:
+    /// @brief Written by the DMA during a transfer, the inputs followed by the returned pattern.
+    std::array<uint8_t, frame_size> receive_buffer = {0};
+    uint32_t frames = 0;
+};
@@ -1,86 +1,104 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
+#include <modm/architecture/interface/atomic_lock.hpp>
 #include <modm/processing.hpp>
 #include "board.hpp"
+#include "chain.hpp"
+#include "chain_group.hpp"
+#include "ioposition.hpp"
+#include "refresh_policy.hpp"
+#include "refresh_timing.hpp"
 
-struct ioposition
+/// @brief Refreshes all chains of the expansion.
+/// @details Outputs are written to the back buffers of the chains. When a refresh is due, see
+/// refresh_policy, the back buffers are published and the front buffers of all chains are
+/// shifted out by their transports at the same time without blocking, the fiber sleeps until
+/// every transfer completed and then latches all chains at once, see chain_group. Alternatively
+/// a hardware timer starts the refreshes, see pace_with(). A looped_back chain whose loopback
+/// check keeps failing is logged and handed to on_fault once.
+/// @tparam Latch The latch of all chains, which latches them on its rising edge.
+/// @tparam SleepTime The refresh period in ms of the PERIODIC mode.
+/// @tparam Transports One transport per chain, which starts a transfer with start(tx, rx, length)
+/// and suspends the fiber until it completed with wait(), see spi_dma_transport.
+template <typename Latch, int SleepTime, typename... Transports>
+class controller : public modm::Fiber<>, public chain_group<Latch, Transports...>
 {
-    size_t board;
-    uint8_t bit_pos;
-};
-struct board
-{
-    const size_t inputs;
-    const size_t outputs;
-    constexpr size_t buffer_size() const
+    using group_type = chain_group<Latch, Transports...>;
+
+public:
+    controller() : Fiber([this]
+                         { this->update(); })
     {
-        return std::max(inputs, outputs);
-    }
-};
-static constexpr board board_a = {
-    .inputs = 0,
-    .outputs = 1,
-};
-static constexpr std::array<board, 7> boards = {
-    board_a,
-    board_a,
-    board_a,
-    board_a,
-    board_a,
-    board_a,
-    board_a,
-};
+        policy.period = std::chrono::milliseconds(SleepTime);
+    };
 
-static constexpr size_t calculate_buffer_size()
-{
-    size_t size = 0;
-    for (const auto &b : boards)
+    using policy_type = refresh_policy<modm::PreciseClock>;
+    using timing_type = refresh_timing<>;
+
+    /// @brief Called in the fiber of the controller when a chain became faulty.
+    /// @details Should bring the layout into a safe state, the outputs it sets are sent with the
+    /// next refresh to all boards the chain still reaches.
+    using fault_handler = void (*)(size_t chain, const integrity_report &report);
+
+    /// @brief When the chains are refreshed, may be changed at any time.
+    /// @details In ON_CHANGE mode keep_alive bounds the age of the inputs. Once paced by a timer
+    /// its period replaces the period of the policy and is the lower bound of min_interval.
+    policy_type policy;
+
+    /// @brief Handles faulty chains, may be nullptr.
+    fault_handler on_fault = nullptr;
+
+    /// @brief Counters of the refreshes so far.
+    const refresh_statistics &statistics() const { return policy.statistics(); }
+
+    /// @brief Period and jitter of the refreshes so far, the jitter only for periodic refreshes.
+    timing_type timing() const
     {
-        size += b.buffer_size();
+        // Written by the timer interrupt once paced
+        modm::atomic::Lock lock;
+        return timing_data;
     }
-    return size;
-}
-static constexpr size_t calculate_buffer_offset(size_t board_index)
-{
-    size_t offset = 0;
 
-    for (size_t i = boards.size() - 1; i >= board_index; --i)
+    /// @brief Starts new period and jitter statistics.
+    /// @param bin_width The width of a bin of the jitter histogram.
+    void reset_timing(const timing_type::duration bin_width)
     {
-        if (i <= board_index)
-        {
-            break;
-        }
-        offset += boards[i].buffer_size();
+        modm::atomic::Lock lock;
+        timing_data = {.bin_width = bin_width};
     }
-    return offset;
-}
-template <typename CS, typename SpiMaster, int SleepTime>
-class controller : public modm::Fiber<>
-{
-public:
-    controller() : Fiber([this]
-                         { this->update(); }) {};
 
-    static constexpr size_t buffer_size = calculate_buffer_size();
+    /// @brief Lets a hardware timer start every refresh instead of the fiber.
+    /// @details The interrupt of the timer lowers the latch and starts the transfers of the frames
+    /// prepared by the fiber, and the interrupt of the last completed transfer raises the latch,
+    /// so the outputs change a fixed time after every tick however busy the fibers are. The
+    /// fiber only takes over the inputs and prepares the next frames. The ticks are the refresh
+    /// slots of the policy: in PERIODIC mode every tick refreshes, in ON_CHANGE mode the fiber
+    /// prepares frames only when the outputs changed or keep_alive is due, and min_interval
+    /// after the last refresh, so the ticks in between are skipped. A tick at which a due
+    /// refresh is not prepared yet is counted as missed, see timing(). Cannot be undone.
+    /// @tparam Timer The timer, see refresh_timer, which must be initialized already.
+    template <typename Timer>
+    void pace_with()
+    {
+        (Transports::set_complete_handler(&controller::handle_transfer_complete), ...);
+        nominal_period = std::chrono::duration_cast<timing_type::duration>(Timer::period());
+        policy.period = Timer::period();
+        policy.min_interval = std::max<policy_type::duration>(policy.min_interval, policy.period);
+        paced = true;
+        Timer::attach(&controller::handle_tick, this);
+    }
 
-    std::array<uint8_t, buffer_size> out_buffer = {0};
-    std::array<uint8_t, buffer_size> in_buffer = {0};
+    using group_type::get_input;
+    using group_type::set_output;
 
     void set_buffer(const ioposition &pos, bool state)
     {
-        if (pos.board < boards.size())
+        if (pos.chain < group_type::count)
         {
-            if (pos.bit_pos / 8 < boards[pos.board].outputs)
+            if (is_valid_output(pos))
             {
-                auto buffer_index = calculate_buffer_offset(pos.board) + pos.bit_pos / 8;
-                if (state)
-                {
-                    out_buffer[buffer_index] |= static_cast<uint8_t>((1 << (pos.bit_pos % 8)));
-                }
-                else
-                {
-                    out_buffer[buffer_index] &= static_cast<uint8_t>(~(1 << (pos.bit_pos % 8)));
-                }
+                set_output(resolve_output(pos), state);
             }
             else
             {
@@ -89,18 +107,151 @@ public:
         }
         else
         {
-            MODM_LOG_ERROR << "Invalid board position: " << pos.board << modm::endl;
+            MODM_LOG_ERROR << "Invalid chain: " << pos.chain << modm::endl;
+        }
+    }
+
+    /// @brief Reads an input, checked at runtime.
+    /// @return The state of the input, false if it does not exist.
+    bool get_input(const ioposition &pos) const
+    {
+        if (not is_valid_input(pos))
+        {
+            MODM_LOG_ERROR << "Invalid input position: " << pos.bit_pos << " for board: " << pos.board << modm::endl;
+            return false;
         }
+        return get_input(resolve_input(pos));
     }
 
     void update()
     {
         while (true)
         {
-            CS::reset();
-            SpiMaster::transferBlocking(out_buffer.data(), nullptr, buffer_size);
-            CS::set();
-            modm::this_fiber::sleep_for(2ms);
+            const auto failed = paced ? refresh_paced() : refresh_now();
+            if (failed != 0)
+            {
+                MODM_LOG_ERROR << "Expansion chain transfer failed, chain mask: " << failed << modm::endl;
+            }
+            if (const auto faults = this->take_faults(); faults != 0)
+            {
+                handle_faults(faults);
+            }
+        }
+    }
+
+private:
+    /// @brief Waits until a refresh is due according to the policy and refreshes.
+    uint32_t refresh_now()
+    {
+        wait_until_due();
+        // Writes arriving until then are coalesced into this refresh
+        modm::this_fiber::sleep_until(policy.earliest());
+        const auto now = modm::PreciseClock::now();
+        policy.record(now, this->publish());
+        record_period(now, policy.mode == refresh_mode::PERIODIC ? std::chrono::duration_cast<timing_type::duration>(policy.period) : timing_type::duration::zero());
+        return this->refresh();
+    }
+
+    /// @brief Prepares the next frames once the policy asks for a refresh and waits until the
+    /// timer started and completed them.
+    uint32_t refresh_paced()
+    {
+        // In PERIODIC mode every tick refreshes, the timer keeps the period
+        if (policy.mode == refresh_mode::ON_CHANGE)
+        {
+            wait_until_due();
+            modm::this_fiber::sleep_until(policy.earliest());
+        }
+        due = true;
+        policy.record(modm::PreciseClock::now(), this->publish());
+        this->prepare();
+        armed = true;
+        modm::this_fiber::poll([this]
+                               { return not armed; });
+        return this->finish_transfers();
+    }
+
+    /// @brief Waits in ON_CHANGE mode until the outputs changed or keep_alive is due.
+    void wait_until_due()
+    {
+        if (policy.mode == refresh_mode::ON_CHANGE)
+        {
+            modm::this_fiber::poll_until(policy.deadline(), [this]
+                                         { return this->is_modified(); });
+        }
+    }
+
+    /// @brief Starts a prepared refresh, called by the timer interrupt.
+    static void handle_tick(void *context)
+    {
+        auto &self = *static_cast<controller *>(context);
+        const bool periodic = self.policy.mode == refresh_mode::PERIODIC;
+        if (not self.armed)
+        {
+            // Ticks the policy skips on purpose are no misses
+            if (periodic or self.due)
+            {
+                ++self.timing_data.missed;
+            }
+            return;
+        }
+        self.record_period(modm::PreciseClock::now(), periodic ? self.nominal_period : timing_type::duration::zero());
+        remaining = group_type::count;
+        self.begin_transfers();
+        self.armed = false;
+        self.due = false;
+    }
+
+    /// @brief Latches the chains once the last transfer completed, called by the DMA interrupts.
+    static void handle_transfer_complete()
+    {
+        remaining = remaining - 1;
+        if (remaining == 0)
+        {
+            Latch::set();
+        }
+    }
+
+    void record_period(const modm::PreciseClock::time_point now, const timing_type::duration nominal)
+    {
+        if (started)
+        {
+            timing_data.record(std::chrono::duration_cast<timing_type::duration>(now - last_start), nominal);
+        }
+        last_start = now;
+        started = true;
+    }
+
+    void handle_faults(const uint32_t faults)
+    {
+        for (size_t i = 0; i < group_type::count; ++i)
+        {
+            if (faults & (1u << i))
+            {
+                const auto &report = this->integrity(i);
+                MODM_LOG_ERROR << "Expansion chain " << i << " faulty, status: " << static_cast<int>(report.status)
+                               << " length error: " << report.length_error << " stuck high: " << report.stuck_high
+                               << " stuck low: " << report.stuck_low << modm::endl;
+                if (on_fault)
+                {
+                    on_fault(i, report);
+                }
+            }
         }
     }
-};
\ No newline at end of file
+
+    timing_type timing_data{};
+    timing_type::duration nominal_period{};
+    modm::PreciseClock::time_point last_start{};
+    bool started = false;
+    bool paced = false;
+
+    /// @brief Set by the fiber when the next frames are prepared, cleared by the timer interrupt.
+    volatile bool armed = false;
+
+    /// @brief Set by the fiber when the policy asked for a refresh, cleared by the timer interrupt.
+    volatile bool due = false;
+
+    /// @brief Transfers of the running paced refresh which did not complete yet.
+    static inline volatile size_t remaining = 0;
+};
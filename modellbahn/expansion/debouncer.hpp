@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "chain.hpp"
+
+/// @brief Debounces the inputs of a chain buffer, 32 inputs per word with vertical counters.
+/// @details Every input has a counter of CounterBits bits, stored bit-sliced: plane k holds bit k
+/// of the counters of 32 inputs in one word. A counter counts the consecutive samples which
+/// differ from the debounced state and is cleared by any sample which does not. The state of an
+/// input flips once its counter reaches the configured number of samples. The cost of update()
+/// is a few instructions per counter bit and word, independent of the values of the inputs.
+/// @tparam Bytes The size of the chain buffer.
+/// @tparam CounterBits The counter width, up to 2^CounterBits - 1 samples can be configured.
+template <size_t Bytes, size_t CounterBits = 3>
+class debouncer
+{
+public:
+    using word = uint32_t;
+    static constexpr size_t words = (Bytes + sizeof(word) - 1) / sizeof(word);
+    static constexpr uint32_t max_samples = (1u << CounterBits) - 1;
+
+    static_assert(CounterBits > 0 and CounterBits < 32);
+
+    /// @brief Constructs a debouncer with all inputs low.
+    /// @param samples The number of consecutive samples needed to accept a change.
+    constexpr explicit debouncer(const uint32_t samples = 4) { set_samples(samples); }
+
+    /// @brief Sets the number of consecutive samples needed to accept a change.
+    /// @param samples Clamped to 1..max_samples.
+    constexpr void set_samples(const uint32_t samples)
+    {
+        target = samples < 1 ? 1 : samples > max_samples ? max_samples : samples;
+        for (size_t k = 0; k < CounterBits; ++k)
+        {
+            pattern[k] = (target >> k) & 1 ? ~word(0) : word(0);
+        }
+    }
+
+    constexpr uint32_t samples() const { return target; }
+
+    /// @brief Processes one sample of all inputs.
+    /// @param inputs The chain buffer, Bytes long.
+    void update(const uint8_t *inputs)
+    {
+        std::array<word, words> sample{};
+        std::memcpy(sample.data(), inputs, Bytes);
+        update(sample);
+    }
+
+    /// @brief Processes one sample of all inputs, given as words in the byte order of the buffer.
+    constexpr void update(const std::array<word, words> &sample)
+    {
+        for (size_t i = 0; i < words; ++i)
+        {
+            const word delta = sample[i] ^ debounced[i];
+
+            // Clear the counters of stable inputs and increment the others by one
+            word carry = delta;
+            word match = delta;
+            for (size_t k = 0; k < CounterBits; ++k)
+            {
+                auto &plane = counter[k][i];
+                plane &= delta;
+                const word next_carry = plane & carry;
+                plane ^= carry;
+                carry = next_carry;
+                match &= ~(plane ^ pattern[k]);
+            }
+
+            // Inputs whose counter reached the target flip and start counting again
+            for (size_t k = 0; k < CounterBits; ++k)
+            {
+                counter[k][i] &= ~match;
+            }
+            debounced[i] ^= match;
+            rising_edges[i] = match & debounced[i];
+            falling_edges[i] = match & ~debounced[i];
+        }
+    }
+
+    /// @brief The debounced inputs in the byte order of the chain buffer.
+    const uint8_t *data() const { return reinterpret_cast<const uint8_t *>(debounced.data()); }
+
+    /// @brief Reads a debounced input.
+    /// @param bit The input, see resolve_input().
+    bool test(const input_bit &bit) const { return data()[bit.index] & bit.mask; }
+
+    /// @brief The debounced inputs as words.
+    constexpr const std::array<word, words> &state() const { return debounced; }
+
+    /// @brief The inputs which became high with the last update().
+    constexpr const std::array<word, words> &rising() const { return rising_edges; }
+
+    /// @brief The inputs which became low with the last update().
+    constexpr const std::array<word, words> &falling() const { return falling_edges; }
+
+private:
+    uint32_t target = 1;
+
+    /// @brief Bit k of target in every bit, compared with counter plane k.
+    std::array<word, CounterBits> pattern{};
+    std::array<std::array<word, words>, CounterBits> counter{};
+    std::array<word, words> debounced{};
+    std::array<word, words> rising_edges{};
+    std::array<word, words> falling_edges{};
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Back and front buffer of a chain frame.
+/// @details The application only writes the back buffer. Between two transfers the controller
+/// calls publish(), which makes the back buffer the front buffer and continues writing on a copy
+/// of it. The front buffer is only read by the transfer, so changes made while a transfer runs
+/// end up complete in the next frame instead of torn across two. Both buffers are padded to
+/// whole words for output_mask::apply().
+/// @tparam Bytes The size of a frame.
+/// @tparam Prefix Bytes sent in front of every frame, which the application does not write.
+template <size_t Bytes, size_t Prefix = 0>
+class double_buffer
+{
+public:
+    static constexpr size_t padded_size = (Bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t);
+
+    static_assert(Prefix % sizeof(uint32_t) == 0, "The prefix keeps the frame word aligned");
+
+    /// @brief The buffer the application writes to.
+    constexpr uint8_t *back() { return buffers[1 - front_index].data() + Prefix; }
+
+    constexpr const uint8_t *back() const { return buffers[1 - front_index].data() + Prefix; }
+
+    /// @brief The buffer of the current transfer including the prefix, stable until the next publish().
+    constexpr const uint8_t *front() const { return buffers[front_index].data(); }
+
+    /// @brief The prefix of the front buffer, written before every transfer.
+    constexpr uint8_t *prefix() { return buffers[front_index].data(); }
+
+    /// @brief Marks the back buffer as changed, done by every write of the controller.
+    constexpr void touch() { ++writes; }
+
+    /// @brief Checks if the back buffer changed since the last publish().
+    constexpr bool is_modified() const { return writes != 0; }
+
+    /// @brief Swaps the buffers if the back buffer changed, must not be called while a transfer runs.
+    /// @return The number of writes published, zero if the front buffer did not change.
+    constexpr uint32_t publish()
+    {
+        const auto published = writes;
+        if (published == 0)
+        {
+            return 0;
+        }
+        front_index = 1 - front_index;
+        buffers[1 - front_index] = buffers[front_index];
+        writes = 0;
+        return published;
+    }
+
+private:
+    alignas(uint32_t) std::array<std::array<uint8_t, Prefix + padded_size>, 2> buffers{};
+    size_t front_index = 0;
+    uint32_t writes = 0;
+};
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Position of a single bit in the expansion board chain.
+struct ioposition
+{
+    size_t board;
+    uint8_t bit_pos;
+
+    /// @brief The index of the chain, see chain_set.
+    uint8_t chain = 0;
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+enum class integrity_status : uint8_t
+{
+    /// @brief No frame was checked yet.
+    UNKNOWN,
+    /// @brief The pattern returned unchanged after the length of the chain.
+    OK,
+    /// @brief The pattern returned after another length, a board is missing or too many.
+    LENGTH_MISMATCH,
+    /// @brief The pattern returned with some bits stuck high or low.
+    STUCK_BITS,
+    /// @brief Nothing but a constant level returned, the chain is broken or much longer.
+    NO_LOOPBACK,
+};
+
+/// @brief Result of the integrity checks of a chain.
+struct integrity_report
+{
+    /// @brief The result of the last check.
+    integrity_status status = integrity_status::UNKNOWN;
+
+    /// @brief Measured minus configured length of the chain in bytes, set with LENGTH_MISMATCH.
+    int16_t length_error = 0;
+
+    /// @brief Failed checks in a row.
+    uint16_t consecutive = 0;
+
+    /// @brief Pattern bits which returned high instead of low, set with STUCK_BITS.
+    uint32_t stuck_high = 0;
+
+    /// @brief Pattern bits which returned low instead of high, set with STUCK_BITS.
+    uint32_t stuck_low = 0;
+
+    /// @brief Frames checked so far.
+    uint32_t checks = 0;
+
+    /// @brief Failed checks so far.
+    uint32_t errors = 0;
+
+    /// @brief Set once fault_threshold checks failed in a row, stays set until clear_fault().
+    bool fault = false;
+};
+
+/// @brief Checks a chain with a pattern sent in front of every frame.
+/// @details The boards shift out their old contents while a frame is shifted in, so the bytes
+/// sent first return on MISO after as many bytes as the chain holds, and the rest of the frame
+/// stays in the boards. A pattern sent in front of the outputs therefore returns right after the
+/// inputs in the same transfer. The upper half of the pattern is the complement of the lower
+/// half, so a bit stuck in the chain is wrong in every frame whatever its position, and the
+/// pattern changes with every frame, so a pattern found at another offset gives the actual
+/// length of the chain.
+/// @tparam Bytes The configured length of the chain, the offset the pattern has to return at.
+template <size_t Bytes>
+class loopback_check
+{
+public:
+    static constexpr size_t pattern_size = sizeof(uint32_t);
+
+    /// @brief Failed checks in a row which make a fault, single disturbed frames are tolerated.
+    uint16_t fault_threshold = 3;
+
+    /// @brief Writes the pattern of the next frame.
+    /// @param prefix The pattern_size bytes sent in front of the frame.
+    void fill(uint8_t *prefix)
+    {
+        ++sequence;
+        const uint32_t half = (sequence * 0x9e37'79b9u ^ 0xa55a'c33cu) >> 16;
+        expected = half | (~half << 16);
+        std::memcpy(prefix, &expected, pattern_size);
+    }
+
+    /// @brief Checks the pattern returned with a frame.
+    /// @param frame The received frame of Bytes + pattern_size bytes.
+    /// @return True if the pattern returned unchanged.
+    bool verify(const uint8_t *frame)
+    {
+        ++result.checks;
+        if (word_at(frame, Bytes) == expected)
+        {
+            result.status = integrity_status::OK;
+            result.consecutive = 0;
+            return true;
+        }
+        diagnose(frame);
+        ++result.errors;
+        if (result.consecutive < UINT16_MAX)
+        {
+            ++result.consecutive;
+        }
+        if (result.consecutive >= fault_threshold)
+        {
+            result.fault = true;
+        }
+        return false;
+    }
+
+    constexpr const integrity_report &report() const { return result; }
+
+    /// @brief Clears a fault after the chain was repaired.
+    constexpr void clear_fault()
+    {
+        result.fault = false;
+        result.consecutive = 0;
+    }
+
+private:
+    static uint32_t word_at(const uint8_t *frame, const size_t offset)
+    {
+        uint32_t value;
+        std::memcpy(&value, frame + offset, sizeof(value));
+        return value;
+    }
+
+    void diagnose(const uint8_t *frame)
+    {
+        result.length_error = 0;
+        result.stuck_high = 0;
+        result.stuck_low = 0;
+
+        // A shorter chain returns the pattern earlier, a longer one only its first bytes
+        for (size_t missing = 1; missing <= Bytes; ++missing)
+        {
+            if (word_at(frame, Bytes - missing) == expected)
+            {
+                result.status = integrity_status::LENGTH_MISMATCH;
+                result.length_error = static_cast<int16_t>(-static_cast<int>(missing));
+                return;
+            }
+        }
+        for (size_t extra = 1; extra < pattern_size; ++extra)
+        {
+            if (std::memcmp(frame + Bytes + extra, &expected, pattern_size - extra) == 0)
+            {
+                result.status = integrity_status::LENGTH_MISMATCH;
+                result.length_error = static_cast<int16_t>(extra);
+                return;
+            }
+        }
+
+        const auto value = word_at(frame, Bytes);
+        if (value == 0 or value == ~uint32_t(0))
+        {
+            result.status = integrity_status::NO_LOOPBACK;
+            return;
+        }
+        result.status = integrity_status::STUCK_BITS;
+        result.stuck_high = (value ^ expected) & value;
+        result.stuck_low = (value ^ expected) & expected;
+    }
+
+    uint32_t sequence = 0;
+    uint32_t expected = 0;
+    integrity_report result{};
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+enum class refresh_mode : uint8_t
+{
+    /// @brief Refresh every period, changed or not.
+    PERIODIC,
+    /// @brief Refresh as soon as the outputs changed, but at most every min_interval, and at least every keep_alive.
+    ON_CHANGE,
+};
+
+/// @brief Counters of the refreshes of a chain.
+struct refresh_statistics
+{
+    /// @brief Transfers started.
+    uint32_t issued = 0;
+
+    /// @brief Refresh slots at the maximum rate in which no transfer was needed.
+    uint32_t skipped = 0;
+
+    /// @brief Writes merged into the transfer of an earlier write.
+    uint32_t coalesced = 0;
+};
+
+/// @brief Decides when a chain has to be refreshed.
+/// @details Only computes deadlines, the controller waits for them. Does not depend on modm, so
+/// any clock with the interface of std::chrono clocks can be used.
+/// @tparam Clock The clock of the time points.
+template <typename Clock>
+struct refresh_policy
+{
+    using duration = typename Clock::duration;
+    using time_point = typename Clock::time_point;
+
+    refresh_mode mode = refresh_mode::PERIODIC;
+
+    /// @brief The refresh period in PERIODIC mode.
+    duration period = std::chrono::milliseconds(2);
+
+    /// @brief The shortest time between two refreshes in ON_CHANGE mode, caps the refresh rate.
+    duration min_interval = std::chrono::milliseconds(1);
+
+    /// @brief The longest time without a refresh in ON_CHANGE mode.
+    duration keep_alive = std::chrono::milliseconds(100);
+
+    /// @brief The time the next refresh is due even without changes.
+    constexpr time_point deadline() const
+    {
+        return last + (mode == refresh_mode::PERIODIC ? period : keep_alive);
+    }
+
+    /// @brief The earliest time the next refresh may start.
+    constexpr time_point earliest() const
+    {
+        return last + interval();
+    }
+
+    /// @brief Records a refresh.
+    /// @param now The time the refresh starts.
+    /// @param writes The number of writes published for it, see double_buffer::publish().
+    constexpr void record(const time_point now, const uint32_t writes)
+    {
+        ++counters.issued;
+        if (writes > 1)
+        {
+            counters.coalesced += writes - 1;
+        }
+        if (started and interval() > duration::zero())
+        {
+            const auto slots = static_cast<uint32_t>((now - last) / interval());
+            if (slots > 1)
+            {
+                counters.skipped += slots - 1;
+            }
+        }
+        last = now;
+        started = true;
+    }
+
+    constexpr const refresh_statistics &statistics() const { return counters; }
+
+private:
+    constexpr duration interval() const
+    {
+        return mode == refresh_mode::PERIODIC ? period : min_interval;
+    }
+
+    time_point last{};
+    bool started = false;
+    refresh_statistics counters{};
+};
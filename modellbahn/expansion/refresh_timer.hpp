@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <modm/platform.hpp>
+
+/// @brief Paces the refresh of the expansion chains with a hardware timer.
+/// @details The update interrupt of the timer calls the attached handler, see
+/// controller::pace_with(). The interrupt has to be forwarded to handle_interrupt() with
+/// MODM_ISR of the timer.
+/// @tparam Timer A modm timer with an update interrupt, e.g. Timer7.
+template <typename Timer>
+class refresh_timer
+{
+public:
+    using handler = void (*)(void *context);
+
+    /// @brief Starts the timer.
+    /// @param period The refresh period.
+    /// @param priority The priority of the update interrupt. The DMA interrupts of the chains run
+    /// at the more urgent default priority 1 and may preempt the tick once a transfer started,
+    /// the handler counts the transfers before it starts them.
+    template <typename SystemClock>
+    static void initialize(const std::chrono::microseconds period, const uint8_t priority = 4)
+    {
+        Timer::enable();
+        Timer::setMode(Timer::Mode::UpCounter);
+        Timer::template setPeriod<SystemClock>(period);
+        Timer::enableInterruptVector(true, priority);
+        Timer::enableInterrupt(Timer::Interrupt::Update);
+        Timer::start();
+        refresh_period = period;
+    }
+
+    static std::chrono::microseconds period() { return refresh_period; }
+
+    /// @brief Sets the function called with every period.
+    static void attach(const handler function, void *const function_context)
+    {
+        Timer::disableInterrupt(Timer::Interrupt::Update);
+        callback = function;
+        context = function_context;
+        Timer::enableInterrupt(Timer::Interrupt::Update);
+    }
+
+    static void handle_interrupt()
+    {
+        Timer::acknowledgeInterruptFlags(Timer::InterruptFlag::Update);
+        if (callback)
+        {
+            callback(context);
+        }
+    }
+
+private:
+    static inline handler callback = nullptr;
+    static inline void *context = nullptr;
+    static inline std::chrono::microseconds refresh_period{};
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Period and jitter statistics of the refreshes of the chains.
+/// @details The jitter of a period is its deviation from the nominal period. The histogram
+/// counts the jitter in bins of bin_width, the last bin counts everything beyond. Does not
+/// depend on modm, the controller records into it.
+/// @tparam Bins The number of bins of the jitter histogram.
+template <size_t Bins = 8>
+struct refresh_timing
+{
+    using duration = std::chrono::microseconds;
+
+    static_assert(Bins > 0);
+
+    /// @brief The width of a bin of the jitter histogram.
+    duration bin_width = duration(20);
+
+    /// @brief Periods measured.
+    uint32_t periods = 0;
+
+    /// @brief Timer ticks at which a due refresh was not prepared yet, so none was started.
+    uint32_t missed = 0;
+
+    duration min = duration::max();
+    duration max = duration::zero();
+
+    /// @brief Sum of all periods, for average().
+    duration total = duration::zero();
+
+    /// @brief Number of periods per jitter bin.
+    std::array<uint32_t, Bins> jitter{};
+
+    /// @brief The average period, zero before the first one.
+    constexpr duration average() const
+    {
+        return periods ? total / periods : duration::zero();
+    }
+
+    /// @brief Records the time between two refreshes.
+    /// @param period The time since the previous refresh.
+    /// @param nominal The intended period, zero if the refreshes are not periodic.
+    constexpr void record(const duration period, const duration nominal)
+    {
+        ++periods;
+        total += period;
+        min = period < min ? period : min;
+        max = period > max ? period : max;
+        if (nominal > duration::zero() and bin_width > duration::zero())
+        {
+            const auto deviation = period > nominal ? period - nominal : nominal - period;
+            const auto bin = static_cast<size_t>(deviation / bin_width);
+            ++jitter[bin < Bins ? bin : Bins - 1];
+        }
+    }
+
+    /// @brief Clears all counters, keeping bin_width.
+    constexpr void reset()
+    {
+        *this = refresh_timing{.bin_width = bin_width};
+    }
+};
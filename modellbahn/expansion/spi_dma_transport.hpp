@@ -0,0 +1,125 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <modm/platform.hpp>
+#include <modm/processing/fiber/semaphore.hpp>
+
+/// @brief Non-blocking full frame transfers over an SPI with a pair of DMA channels.
+/// @details Takes over the channels configured by the matching SpiMaster_Dma, whose transfer
+/// functions must not be used any more after initialize(). A transfer is started with start()
+/// and returns at once. wait() suspends the calling fiber until the receive channel completes,
+/// which happens after the last byte was clocked out, so the chain can be latched right after.
+/// @tparam SpiHal The SPI HAL, e.g. SpiHal3.
+/// @tparam DmaRx The DMA channel receiving from the SPI.
+/// @tparam DmaTx The DMA channel sending to the SPI.
+template <typename SpiHal, typename DmaRx, typename DmaTx>
+class spi_dma_transport
+{
+public:
+    using complete_handler = void (*)();
+
+    /// @brief Installs the interrupt handlers, call after SpiMaster_Dma::initialize().
+    static void initialize()
+    {
+        DmaRx::setTransferCompleteIrqHandler(handle_complete);
+        DmaRx::setTransferErrorIrqHandler(handle_error);
+        DmaTx::setTransferCompleteIrqHandler(handle_transmit_complete);
+        DmaTx::setTransferErrorIrqHandler(handle_error);
+    }
+
+    /// @brief Starts a transfer without waiting for it.
+    /// @param tx The data to send, must stay unchanged until the transfer completed.
+    /// @param rx The buffer for the received data, nullptr to discard it.
+    /// @param length The number of bytes.
+    static void start(const uint8_t *tx, uint8_t *rx, const size_t length)
+    {
+        error = false;
+        busy = true;
+        pending = true;
+        SpiHal::enableInterrupt(modm::platform::SpiBase::Interrupt::TxDmaEnable | modm::platform::SpiBase::Interrupt::RxDmaEnable);
+
+        DmaTx::setMemoryAddress(uint32_t(tx));
+        DmaTx::setMemoryIncrementMode(true);
+        if (rx)
+        {
+            DmaRx::setMemoryAddress(uint32_t(rx));
+            DmaRx::setMemoryIncrementMode(true);
+        }
+        else
+        {
+            DmaRx::setMemoryAddress(uint32_t(&dummy));
+            DmaRx::setMemoryIncrementMode(false);
+        }
+        DmaRx::setDataLength(length);
+        DmaRx::start();
+        DmaTx::setDataLength(length);
+        DmaTx::start();
+    }
+
+    /// @brief Sets a function called in the interrupt of every finished transfer, failed or not.
+    /// @details Lets an interrupt react to the end of a transfer without waiting for the fiber.
+    static void set_complete_handler(const complete_handler handler)
+    {
+        on_complete = handler;
+    }
+
+    /// @brief Checks if a transfer is running.
+    static bool is_busy() { return busy; }
+
+    /// @brief Suspends the calling fiber until the running transfer finished.
+    /// @return False if the transfer was aborted by a DMA error.
+    static bool wait()
+    {
+        // Every start() releases the semaphore exactly once, even if it completed before this call
+        if (pending)
+        {
+            done.acquire();
+            pending = false;
+        }
+        return not error;
+    }
+
+private:
+    static void handle_complete()
+    {
+        DmaRx::stop();
+        SpiHal::disableInterrupt(modm::platform::SpiBase::Interrupt::TxDmaEnable | modm::platform::SpiBase::Interrupt::RxDmaEnable);
+        busy = false;
+        if (on_complete)
+        {
+            on_complete();
+        }
+        done.release();
+    }
+
+    static void handle_transmit_complete()
+    {
+        DmaTx::stop();
+    }
+
+    static void handle_error()
+    {
+        DmaRx::stop();
+        DmaTx::stop();
+        SpiHal::disableInterrupt(modm::platform::SpiBase::Interrupt::TxDmaEnable | modm::platform::SpiBase::Interrupt::RxDmaEnable);
+        error = true;
+        // Both channels may report the error, release only once
+        if (busy)
+        {
+            busy = false;
+            if (on_complete)
+            {
+                on_complete();
+            }
+            done.release();
+        }
+    }
+
+    static inline modm::fiber::binary_semaphore done{0};
+    static inline volatile bool busy = false;
+    static inline volatile bool error = false;
+    // Set by start(), which may run in an interrupt
+    static inline volatile bool pending = false;
+    static inline complete_handler on_complete = nullptr;
+    static inline uint8_t dummy = 0;
+};
@@ -3,7 +3,12 @@
 #include <modm/platform.hpp>
 #include <modm/architecture/interface/clock.hpp>
 #include <modm/debug/logger.hpp>
-#include <modm/driver/adc/adc_sampler.hpp>
+#include "analog/adc_dma_sampler.hpp"
+#include "analog/overcurrent_trip.hpp"
+#include "dcc/track_signal.hpp"
+#include "expansion/refresh_timer.hpp"
+#include "expansion/spi_dma_transport.hpp"
+#include "telemetry/link.hpp"
 
 using namespace modm::platform;
 using namespace modm::literals;
@@ -50,6 +55,7 @@ namespace Board
 		static constexpr uint32_t Timer3 = Apb1Timer;
 		static constexpr uint32_t Timer4 = Apb1Timer;
 		static constexpr uint32_t Timer5 = Apb1Timer;
+		static constexpr uint32_t Timer7 = Apb1Timer;
 		static constexpr uint32_t Timer9 = Apb2Timer;
 		static constexpr uint32_t Timer10 = Apb2Timer;
 		static constexpr uint32_t Timer11 = Apb2Timer;
@@ -124,7 +130,13 @@ namespace Board
 		using AdcCurrent = GpioInputA3;
 		using AdcVoltage = GpioInputC0;
 		using Adc = Adc1;
-		using sensors = modm::AdcSampler<AdcInterrupt1, 3, 100>;
+		using AdcDma = Dma2::Channel0;
+		static constexpr uint32_t AdcClock = 11'250_kHz;
+		/// Current, voltage and temperature, averaged over 100 scans
+		using sensors = adc_dma_sampler<Adc, AdcDma, 3, 100>;
+		/// The sample time of AdcCurrent, short enough to catch the middle of a half bit
+		static constexpr auto CurrentSampleTime = Adc::SampleTime::Cycles28;
+		static constexpr uint32_t CurrentSampleCycles = 28;
 
 		namespace L6226
 		{
@@ -132,6 +144,10 @@ namespace Board
 			using In1 = GpioOutputE13;
 			using In2 = GpioOutputE9;
 			using Timer = Timer1;
+			using Dma = Dma2::Channel5;
+			/// The DCC signal on the track, see dcc/track_signal.hpp
+			using Signal = track_signal<Dma>;
+			/// Call after Dma2::enable()
 			inline void initialize()
 			{
 				// Driver
@@ -140,11 +156,24 @@ namespace Board
 				In2::setOutput(modm::Gpio::Low);
 				Timer::connect<In1::Ch3, In2::Ch1>();
 				Timer::enable();
+				// One period per bit, In1 drives the first half bit and In2 the second
 				Timer::setMode(Timer::Mode::UpCounter);
-				Timer::setPeriod<Board::SystemClock>(80us);
+				Timer::configureOutputChannel(3, Timer::OutputCompareMode::Pwm, 0);
+				Timer::configureOutputChannel(1, Timer::OutputCompareMode::Pwm2, 0);
+				// Channel 2 has no pin, its rising edge starts the ADC scans. It rises half the
+				// sample time before the middle of the first half bit, so the current is sampled
+				// symmetrically around it and away from the polarity reversals
+				Timer::configureOutputChannel(2, Timer::OutputCompareMode::Pwm2, 0);
+				const auto lead = uint64_t(CurrentSampleCycles) * 1'000'000 / AdcClock / 2;
+				Signal::initialize<Board::SystemClock>(static_cast<uint16_t>(lead));
 			}
 		};
 
+		/// Cuts the L6226 in the ADC interrupt, see analog/overcurrent_trip.hpp
+		using Overcurrent = overcurrent_trip<L6226::En, L6226::Timer, Board::SystemClock>;
+		/// The highest allowed reading of AdcCurrent in ADC counts
+		static constexpr uint16_t OvercurrentThreshold = 3'000;
+
 		inline void initialize()
 		{
 			// Leds
@@ -153,21 +182,29 @@ namespace Board
 			Indicator::LedGreen::setOutput(modm::Gpio::Low);
 			LedGreen::setOutput(modm::Gpio::Low);
 
+			Dma2::enable();
 			L6226::initialize();
 			// Adc
-			Adc::Channel sensorMapping[3] = {
+			const Adc::Channel sensorMapping[3] = {
 				Adc::getPinChannel<AdcCurrent>(),
 				Adc::getPinChannel<AdcVoltage>(),
 				Adc::Channel::TemperatureSensor,
 			};
-			uint32_t sensorData[3];
-			Adc1::connect<AdcCurrent::In3, AdcVoltage::In10>();
-			Adc1::initialize<Board::SystemClock, 11'250_kHz>();
-
-			Adc1::enableInterruptVector(5);
-			Adc1::enableInterrupt(Adc1::Interrupt::EndOfRegularConversion);
-
-			sensors::initialize(sensorMapping, sensorData);
+			// A scan takes 23.5us, well within a bit, the temperature sensor needs 10us
+			const sensors::sample_time sampleTimes[3] = {
+				CurrentSampleTime,
+				Adc::SampleTime::Cycles56,
+				Adc::SampleTime::Cycles144,
+			};
+			// Written by the DMA interrupt for as long as the sampler runs
+			static sensors::DataType sensorData[3];
+			Adc::connect<AdcCurrent::In3, AdcVoltage::In10>();
+			Adc::initialize<Board::SystemClock, AdcClock>();
+
+			// Event1 is the channel 2 of Timer1, one scan per bit, see L6226::initialize()
+			sensors::set_trigger(Adc::ExternalTriggerPolarity::RisingEdge, Adc::RegularConversionExternalTrigger::Event1);
+			sensors::initialize(sensorMapping, sampleTimes, sensorData);
+			Overcurrent::initialize(Adc::getPinChannel<AdcCurrent>(), OvercurrentThreshold);
 		}
 	};
 
@@ -176,6 +213,9 @@ namespace Board
 		using DmaRx = Dma1::Channel0;
 		using DmaTx = Dma1::Channel7;
 		using SpiMaster = SpiMaster3_Dma<DmaRx, DmaTx>;
+		using Transport = spi_dma_transport<SpiHal3, DmaRx, DmaTx>;
+		/// Paces the refresh, its interrupt is forwarded in board.cpp
+		using RefreshTimer = refresh_timer<Timer7>;
 		using Cs = GpioD2;
 		using Sck = GpioC10;
 		using Mosi = GpioC12;
@@ -186,10 +226,23 @@ namespace Board
 			SpiMaster::initialize<Board::SystemClock, 5'625_kHz>();
 			SpiMaster::setDataMode(ExpantionBoard::SpiMaster::DataMode::Mode0);
 			SpiMaster::connect<ExpantionBoard::Sck::Sck, ExpantionBoard::Mosi::Mosi, ExpantionBoard::Miso::Miso>();
+			Transport::initialize();
 			Cs::setOutput(Gpio::OutputType::PushPull);
+			RefreshTimer::initialize<Board::SystemClock>(2ms);
 		}
 	};
 
+	/// Flash sector 7 is reserved for a layout image, see track/layout_image.hpp
+	namespace LayoutImage
+	{
+		static constexpr uintptr_t Address = 0x0806'0000;
+		static constexpr size_t Size = 128 * 1024;
+		inline const uint8_t *data()
+		{
+			return reinterpret_cast<const uint8_t *>(Address);
+		}
+	}
+
 	namespace usb
 	{
 		using Vbus = GpioA9;
@@ -208,6 +261,8 @@ namespace Board
 		using Tx = GpioOutputD8;
 		using Rx = GpioInputD9;
 		using Uart = BufferedUart<UsartHal3, UartTxBuffer<2048>>;
+		/// Binary telemetry frames, decoded on the host by tools/telemetry.py
+		using Telemetry = telemetry_link<Uart>;
 	}
 
 	using LoggerDevice = modm::IODeviceWrapper<modm::platform::Itm, modm::IOBuffer::BlockIfFull>;
@@ -218,7 +273,7 @@ namespace Board
 		SysTickTimer::initialize<SystemClock>();
 
 		stlink::Uart::connect<stlink::Tx::Tx, stlink::Rx::Rx>();
-		stlink::Uart::initialize<SystemClock, 115200_Bd>();
+		stlink::Uart::initialize<SystemClock, 921600_Bd>();
 
 		Adapter_A::initialize();
 		Nucleo::initialize();
@@ -22,6 +22,11 @@ modm::log::Logger modm::log::info(loggerDevice);
 modm::log::Logger modm::log::warning(loggerDevice);
 modm::log::Logger modm::log::error(loggerDevice);
 
+MODM_ISR(TIM7)
+{
+	Board::ExpantionBoard::RefreshTimer::handle_interrupt();
+}
+
 // Default all calls to printf to the UART
 modm_extern_c void putchar_(char c)
 {
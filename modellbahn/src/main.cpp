@@ -1,69 +1,102 @@
 #include "board.hpp"
 
+#include "analog/sample_stream.hpp"
 #include "expansion/controller.hpp"
 #include <modm/processing.hpp>
-#include <modm/driver/adc/adc_sampler.hpp>
+
+/// Current, voltage and temperature of all scans, one per DCC bit, averaged over 4 scans each and about 0.5 to 0.8 s deep
+sample_stream<3, 1024> sensor_stream;
 
 modm::Fiber measurement(
     []
     {
         using sensors = Board::Adapter_A::sensors;
+        auto reader = sensor_stream.subscribe();
 
         while (true)
         {
             sensors::startReadout();
             modm::this_fiber::poll(sensors::isReadoutFinished);
-            uint32_t *data = sensors::getData();
+            const auto *data = sensors::getData();
 
-            MODM_LOG_INFO << "current=" << data[0];
-            MODM_LOG_INFO << "\tvoltage=" << data[1];
-            MODM_LOG_INFO << "\ttemperature=" << data[2] << modm::endl;
-            modm::this_fiber::sleep_for(100ms);
+            // Spikes of the current which the average hides
+            uint16_t peak = 0;
+            for (auto block = sensor_stream.peek(reader); not block.empty(); block = sensor_stream.peek(reader))
+            {
+                for (const auto &sample : block)
+                {
+                    peak = sample.values[0] > peak ? sample.values[0] : peak;
+                }
+                sensor_stream.consume(reader, block.size());
+            }
+
+            // One frame of 30 bytes per readout of 100 bits, about every 12 to 20ms
+            Board::stlink::Telemetry::send(measurement_record{
+                .current = static_cast<uint16_t>(data[0]),
+                .voltage = static_cast<uint16_t>(data[1]),
+                .temperature = static_cast<uint16_t>(data[2]),
+                .peak = peak,
+                .trips = static_cast<uint16_t>(Board::Adapter_A::Overcurrent::recovery.trips()),
+                .trip_state = static_cast<uint8_t>(Board::Adapter_A::Overcurrent::recovery.state()),
+                .dropped = reader.dropped,
+            });
         }
     });
-modm::Fiber driver_fiber(
+modm::Fiber protection(
     []
     {
-        namespace L6226 = Board::Adapter_A::L6226;
-        using Timer = L6226::Timer;
-        using In1 = L6226::In1::Ch3;
-        using In2 = L6226::In2::Ch1;
-
-        auto const maxvalue = Timer::getOverflow();
-        Timer::configureOutputChannel<In1>(Timer::OutputCompareMode::Pwm, 0);
-        Timer::configureOutputChannel<In2>(Timer::OutputCompareMode::Pwm, 0);
-        Timer::start();
-        Timer::enableOutput();
+        using Overcurrent = Board::Adapter_A::Overcurrent;
 
-        L6226::En::set();
-        auto steper = 0;
         while (true)
         {
-            if (steper > 0)
-            {
-                Timer::configureOutputChannel<In1>(Timer::OutputCompareMode::Pwm, maxvalue / 2);
-                Timer::configureOutputChannel<In2>(Timer::OutputCompareMode::Pwm, 0);
-            }
-            else
-            {
-                Timer::configureOutputChannel<In1>(Timer::OutputCompareMode::Pwm, 0);
-                Timer::configureOutputChannel<In2>(Timer::OutputCompareMode::Pwm, maxvalue / 2);
-            }
-            if (steper == 1)
-            {
-                steper = -1;
-            }
-            else
+            if (Overcurrent::update())
             {
-                steper = 1;
+                const auto &trip = Overcurrent::recovery.recent(0);
+                MODM_LOG_ERROR << "Overcurrent trip " << trip.retry << ", current=" << trip.value
+                               << " cut latency=" << static_cast<uint32_t>(trip.latency.count()) << "ns";
+                if (Overcurrent::recovery.state() == trip_state::LOCKED_OUT)
+                {
+                    MODM_LOG_ERROR << ", locked out";
+                }
+                MODM_LOG_ERROR << modm::endl;
             }
+            Board::Adapter_A::Indicator::LedYellow::set(Overcurrent::is_tripped());
+            modm::this_fiber::sleep_for(1ms);
+        }
+    });
+modm::Fiber locomotive(
+    []
+    {
+        namespace L6226 = Board::Adapter_A::L6226;
+        using Signal = L6226::Signal;
+        // New decoders answer to address 3
+        constexpr uint16_t address = 3;
+        constexpr uint8_t step = 20;
+
+        L6226::Timer::enableOutput();
+        L6226::En::set();
 
-            modm::this_fiber::sleep_for(500us);
+        // Decoders start after a few reset packets
+        for (int i = 0; i < 10; ++i)
+        {
+            modm::this_fiber::poll([] { return Signal::send(dcc_packet::reset()); });
+        }
+        while (true)
+        {
+            // Repeated, so a decoder which missed a packet or lost power follows within 100ms
+            modm::this_fiber::poll([] { return Signal::send(dcc_packet::speed(address, true, step)); });
+            modm::this_fiber::sleep_for(100ms);
         }
     });
 int main()
 {
     Board::initialize();
+    sensor_stream.set_decimation(4);
+    Board::Adapter_A::sensors::set_block_handler(
+        [](const uint16_t *scans, size_t count)
+        {
+            sensor_stream.push(scans, count, static_cast<uint32_t>(modm::PreciseClock::now().time_since_epoch().count()));
+        });
 
     Board::Adapter_A::Indicator::LedRed::set(true);
     modm::delay(500ms);
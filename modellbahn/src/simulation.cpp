@@ -1,74 +1,207 @@
+#include <algorithm>
+#include <array>
 #include <modm/processing.hpp>
+#include "expansion/controller.hpp"
 #include "track/layout.hpp"
+#include "track/layout_image.hpp"
+#include "track/train_engine.hpp"
 #include "board.hpp"
 
-controller<Board::ExpantionBoard::Cs, Board::ExpantionBoard::SpiMaster, 2> expand_control;
+controller<Board::ExpantionBoard::Cs, 2, Board::ExpantionBoard::Transport> expand_control;
+
+/// @brief Power and switch state of all tracks.
+track_state<track_table.size()> layout_state;
+
+/// @brief Occupancy reported by the track sensors.
+word_bitset<track_table.size()> sensor_occupancy;
+
+/// @brief Layout image from flash, empty if none was found at boot.
+layout_image flash_layout;
+
+/// @brief Set once an expansion chain became faulty, track power stays off until the next reset.
+bool safe_state = false;
+
+constexpr size_t max_trains = 8;
+
+/// @brief Trains running on the layout.
+train_engine<track_table.size(), max_trains> trains(track_table, transitions, layout_state);
+
+/// @brief Sends the state of the tracks and the counters of the expansion controller.
+void send_telemetry()
+{
+    using Telemetry = Board::stlink::Telemetry;
+
+    word_bitset<track_table.size()> powered{};
+    word_bitset<track_table.size()> curved{};
+    for (size_t i = 0; i < track_table.size(); ++i)
+    {
+        powered.set(i, layout_state.powerstate[i] == power::ON);
+        curved.set(i, layout_state.switches[i] == switch_state::CURVED);
+    }
+    auto &frame = Telemetry::begin(telemetry_type::TRACKS);
+    // The bitsets are sized for the compiled layout, a layout image leaves the tracks above its own clear
+    frame.append(tracks_record{
+        .tracks = static_cast<uint16_t>(track_table.size()),
+        .trains = static_cast<uint8_t>(trains.size()),
+        .safe_state = safe_state,
+    });
+    frame.append(powered.words);
+    frame.append(curved.words);
+    frame.append(sensor_occupancy.words);
+    frame.append(trains.occupancy().words);
+    Telemetry::transmit();
+
+    // Periods in µs, longer ones saturate
+    const auto to_record = [](const std::chrono::microseconds period)
+    { return static_cast<uint16_t>(std::min<int64_t>(period.count(), UINT16_MAX)); };
+    const auto &statistics = expand_control.statistics();
+    const auto timing = expand_control.timing();
+    uint16_t faulty = 0;
+    uint32_t integrity_errors = 0;
+    for (size_t i = 0; i < decltype(expand_control)::count; ++i)
+    {
+        const auto &report = expand_control.integrity(i);
+        faulty |= static_cast<uint16_t>(report.fault ? 1u << i : 0u);
+        integrity_errors += report.errors;
+    }
+    Telemetry::send(controller_record{
+        .issued = statistics.issued,
+        .skipped = statistics.skipped,
+        .coalesced = statistics.coalesced,
+        .periods = timing.periods,
+        .missed = timing.missed,
+        .min_period = to_record(timing.periods ? timing.min : timing.min.zero()),
+        .max_period = to_record(timing.max),
+        .average_period = to_record(timing.average()),
+        .faulty = faulty,
+        .integrity_errors = integrity_errors,
+    });
+}
 
 modm::Fiber simulation(
     []
     {
-        /// @brief Pointer to the last track in the sequence.
-        auto last_track = tracks[static_cast<int>(trackid::A_1a)];
+        // Outputs only change on train moves, so refresh on change and keep the chain alive in between
+        expand_control.policy.mode = refresh_mode::ON_CHANGE;
+        // The refresh timer starts every refresh, so actuation does not depend on the load of the fibers
+        expand_control.pace_with<Board::ExpantionBoard::RefreshTimer>();
 
-        /// @brief Pointer to the current track in the sequence.
-        auto current_track = tracks[static_cast<int>(trackid::A_1b)];
+        // With a broken chain the outputs behind the break are unknown, so power off every track still reached
+        expand_control.on_fault = [](size_t, const integrity_report &)
+        {
+            safe_state = true;
+            const auto &tables = trains.tables();
+            for (size_t i = 0; i < tables.size(); ++i)
+            {
+                layout_state.set_power(i, power::OFF);
+                expand_control.set_output(tables.power_bit[i], false);
+            }
+        };
 
-        while (true)
+        // A layout image replaces the compiled tables, the state is sized for the compiled layout
+        const auto image_status = layout_image::check(Board::LayoutImage::data(), Board::LayoutImage::Size, expansion_chains::buffer_sizes);
+        if (image_status == layout_image::status::OK)
         {
-            /// @brief Determines the next track based on the current and last tracks.
-            auto possible_ways = current_track->next_tracks(last_track->id);
-            if (possible_ways[0] == trackid::INVALID)
+            const auto image = layout_image::open(Board::LayoutImage::data());
+            if (trains.use(image.view()))
             {
-                MODM_LOG_ERROR << "Next track not found " << static_cast<int>(current_track->id) << " comming from " << static_cast<int>(last_track->id) << modm::endl;
-                break;
+                flash_layout = image;
+                MODM_LOG_INFO << "Layout image with " << flash_layout.tracks() << " tracks" << modm::endl;
             }
             else
             {
-                auto select = possible_ways[0];
-                if (possible_ways[1] != trackid::INVALID)
-                {
-                    // MODM_LOG_INFO << "Select: " << static_cast<int>(select) << "\tPossible: " << static_cast<int>(possible_ways[1]) << modm::endl;
-                    if (Board::Nucleo::Button::read())
-                    {
-                        select = possible_ways[1];
-                    }
-                }
-
-                current_track->make_way_to(select, last_track->id);
+                MODM_LOG_WARNING << "Layout image with " << image.tracks() << " tracks exceeds the " << track_table.size() << " tracks of the firmware" << modm::endl;
             }
+        }
+        else if (image_status != layout_image::status::MISSING)
+        {
+            MODM_LOG_WARNING << "Layout image rejected (" << static_cast<int>(image_status) << ")" << modm::endl;
+        }
+        const auto &layout = trains.tables();
+        const auto sensed_tracks = layout.sensed<track_table.size()>();
 
-            auto next_id = current_track->next_track(last_track->id);
+        if (trains.add(trackid::A_1b, trackid::A_1a, trains.track_length) == trains.no_train)
+        {
+            MODM_LOG_WARNING << "No train placed, the start tracks are not connected in this layout" << modm::endl;
+        }
 
-            auto next_track = tracks[static_cast<int>(next_id)];
+        // The last status of every train written to the log
+        std::array<train_status, max_trains> reported{};
+        while (true)
+        {
+            if (safe_state)
+            {
+                Board::Nucleo::LedRed::set();
+                modm::this_fiber::sleep_for(100ms);
+                continue;
+            }
 
-            MODM_LOG_INFO << "Current: " << static_cast<int>(current_track->id)
-                          << "\tNext:  " << static_cast<int>(next_track->id)
-                          << "\tLast:  " << static_cast<int>(last_track->id) << modm::endl;
+            // Occupancy from the sensors, compared with the tracks the trains are on
+            const auto sensed = layout.detect_occupancy<track_table.size()>(expand_control.chain<0>().debounced_inputs.data());
+            if (sensed != sensor_occupancy)
+            {
+                auto expected = trains.occupancy();
+                expected &= sensed_tracks;
+                expected ^= sensed;
+                expected.for_each(
+                    [&sensed](size_t i)
+                    {
+                        MODM_LOG_WARNING << "Track " << i << (sensed.test(i) ? " occupied without a train" : " free with a train on it") << modm::endl;
+                    });
+                sensor_occupancy = sensed;
+                trains.set_detected(sensed);
+            }
 
-            last_track = current_track;
-            current_track = next_track;
-            last_track->powerstate = power::OFF;
-            current_track->powerstate = power::ON;
+            trains.tick(
+                [](size_t, const transition &) -> size_t
+                {
+                    return Board::Nucleo::Button::read() ? 1 : 0;
+                });
 
-            /// @brief Updates the power state of the tracks.
-            for (const auto &track : tracks)
+            // The positions go out with the telemetry, the log only tells when a train stops or starts again
+            for (size_t i = 0; i < trains.size(); ++i)
             {
-                expand_control.set_buffer(track->power_pos, track->powerstate == power::ON);
-                if (track->type() == track_type::Switch)
+                if (trains[i].status == reported[i])
                 {
-                    auto handle_switch = static_cast<switch_track *>(track.get());
-                    if (handle_switch->state == switch_state::STRAIGHT)
+                    continue;
+                }
+                reported[i] = trains[i].status;
+                if (trains[i].status == train_status::BLOCKED or trains[i].status == train_status::COLLISION)
+                {
+                    MODM_LOG_ERROR << "Train " << i << (trains[i].status == train_status::BLOCKED ? " blocked" : " stopped before collision")
+                                   << " at " << static_cast<int>(trains.current_of(i)) << " comming from " << static_cast<int>(trains.previous_of(i)) << modm::endl;
+                }
+                else if (trains[i].status == train_status::RUNNING)
+                {
+                    MODM_LOG_INFO << "Train " << i << " running at " << static_cast<int>(trains.current_of(i)) << modm::endl;
+                }
+            }
+
+            /// @brief Updates the outputs of the tracks which changed since the last tick.
+            layout_state.for_each_change(
+                [&layout](size_t i)
+                {
+                    // The state is sized for the compiled layout, a layout image may have fewer tracks
+                    if (i >= layout.size())
                     {
-                        expand_control.set_buffer(handle_switch->straight, true);
-                        expand_control.set_buffer(handle_switch->curved, false);
+                        return;
                     }
-                    else if (handle_switch->state == switch_state::CURVED)
+                    expand_control.set_output(layout.power_bit[i], layout_state.powerstate[i] == power::ON);
+                    if (layout.type[i] == track_type::Switch)
                     {
-                        expand_control.set_buffer(handle_switch->straight, false);
-                        expand_control.set_buffer(handle_switch->curved, true);
+                        if (layout_state.switches[i] == switch_state::STRAIGHT)
+                        {
+                            expand_control.set_output(layout.straight_bit[i], true);
+                            expand_control.set_output(layout.curved_bit[i], false);
+                        }
+                        else if (layout_state.switches[i] == switch_state::CURVED)
+                        {
+                            expand_control.set_output(layout.straight_bit[i], false);
+                            expand_control.set_output(layout.curved_bit[i], true);
+                        }
                     }
-                }
-            }
+                });
+            send_telemetry();
             Board::Nucleo::LedBlue::toggle();
             modm::this_fiber::sleep_for(100ms);
         }
@@ -0,0 +1,171 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <modm/math/utils/crc.hpp>
+
+/// @brief The content of a telemetry frame, tells the decoder the layout of the payload.
+enum class telemetry_type : uint8_t
+{
+    /// @brief A measurement_record.
+    MEASUREMENT = 1,
+    /// @brief A tracks_record followed by four bitsets of the tracks.
+    TRACKS = 2,
+    /// @brief A controller_record.
+    CONTROLLER = 3,
+};
+
+/// @brief Header in front of every telemetry frame.
+/// @details A frame is the header, length bytes of payload and the CRC16-CCITT of the header
+/// from type up to the end of the payload, see modm::math::crc16_ccitt(). A decoder finds the
+/// frames by the sync word and drops every frame with a wrong CRC. Everything is little endian
+/// like the target, the host decoder is tools/telemetry.py.
+struct telemetry_header
+{
+    static constexpr uint16_t sync_word = 0x5aa5;
+    static constexpr uint8_t telemetry_version = 1;
+
+    uint16_t sync = sync_word;
+    telemetry_type type;
+    uint8_t version = telemetry_version;
+
+    /// @brief The length of the payload.
+    uint16_t length;
+
+    /// @brief Counts all frames, gaps show frames lost on the way.
+    uint16_t sequence;
+
+    /// @brief The time of the content in µs.
+    uint32_t time;
+};
+
+/// @brief Readout of the adapter sensors.
+struct measurement_record
+{
+    static constexpr auto type = telemetry_type::MEASUREMENT;
+
+    /// @brief The averages of the readout in ADC counts.
+    uint16_t current;
+    uint16_t voltage;
+    uint16_t temperature;
+
+    /// @brief The highest current of all streamed samples since the previous record.
+    uint16_t peak;
+
+    /// @brief Overcurrent trips so far.
+    uint16_t trips;
+
+    /// @brief The trip_state of the overcurrent protection.
+    uint8_t trip_state;
+    uint8_t reserved = 0;
+
+    /// @brief Streamed samples the measurement missed so far.
+    uint32_t dropped;
+};
+
+/// @brief State of the layout, followed by four bitsets of word_bitset<tracks>::word_count words.
+/// @details The bitsets are powered tracks, curved switches, occupancy reported by the sensors
+/// and tracks occupied by trains, with track i in bit i % 32 of word i / 32.
+struct tracks_record
+{
+    static constexpr auto type = telemetry_type::TRACKS;
+
+    /// @brief Number of tracks in the bitsets, the decoder derives their word count from it.
+    uint16_t tracks;
+    uint8_t trains;
+
+    /// @brief Set once the tracks were powered off because of a faulty chain.
+    uint8_t safe_state;
+};
+
+/// @brief Counters of the expansion controller.
+struct controller_record
+{
+    static constexpr auto type = telemetry_type::CONTROLLER;
+
+    /// @brief See refresh_statistics.
+    uint32_t issued;
+    uint32_t skipped;
+    uint32_t coalesced;
+
+    /// @brief See refresh_timing, the periods in µs up to 65535.
+    uint32_t periods;
+    uint32_t missed;
+    uint16_t min_period;
+    uint16_t max_period;
+    uint16_t average_period;
+
+    /// @brief Chains with a fault of the loopback check, one bit per chain.
+    uint16_t faulty;
+
+    /// @brief Failed loopback checks of all chains so far.
+    uint32_t integrity_errors;
+};
+
+// Written on the target and decoded on the host, so the layout of every record is fixed
+static_assert(sizeof(telemetry_header) == 12);
+static_assert(sizeof(measurement_record) == 16);
+static_assert(sizeof(tracks_record) == 4);
+static_assert(sizeof(controller_record) == 32);
+
+/// @brief Builds one telemetry frame.
+/// @tparam Capacity The largest payload.
+template <size_t Capacity>
+class telemetry_frame
+{
+public:
+    static constexpr size_t crc_size = sizeof(uint16_t);
+
+    /// @brief Starts a new frame, dropping the previous one.
+    void begin(const telemetry_type type, const uint16_t sequence, const uint32_t time)
+    {
+        const telemetry_header header{.type = type, .length = 0, .sequence = sequence, .time = time};
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        size = sizeof(header);
+        overflow = false;
+    }
+
+    /// @brief Appends a record or any other trivially copyable value to the payload.
+    template <typename T>
+    void append(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        append(std::span(reinterpret_cast<const uint8_t *>(&value), sizeof(value)));
+    }
+
+    void append(const std::span<const uint8_t> data)
+    {
+        if (size + data.size() > sizeof(telemetry_header) + Capacity)
+        {
+            overflow = true;
+            return;
+        }
+        std::memcpy(bytes.data() + size, data.data(), data.size());
+        size += data.size();
+    }
+
+    /// @brief Fills in the length and the CRC.
+    /// @return The complete frame, empty if the payload did not fit.
+    std::span<const uint8_t> finish()
+    {
+        if (overflow)
+        {
+            return {};
+        }
+        const auto length = static_cast<uint16_t>(size - sizeof(telemetry_header));
+        std::memcpy(bytes.data() + offsetof(telemetry_header, length), &length, sizeof(length));
+        // The sync word is left out, so the CRC does not depend on how the decoder found the frame
+        constexpr size_t start = offsetof(telemetry_header, type);
+        const uint16_t crc = modm::math::crc16_ccitt(bytes.data() + start, size - start);
+        std::memcpy(bytes.data() + size, &crc, sizeof(crc));
+        return {bytes.data(), size + crc_size};
+    }
+
+private:
+    alignas(uint32_t) std::array<uint8_t, sizeof(telemetry_header) + Capacity + crc_size> bytes{};
+    size_t size = 0;
+    bool overflow = false;
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <modm/architecture/interface/clock.hpp>
+#include "frame.hpp"
+
+/// @brief Sends telemetry frames over a buffered UART without ever waiting.
+/// @details A frame goes into the transmit buffer of the UART as a whole or, if it does not fit,
+/// is dropped and counted, so a slow receiver never stalls the fibers and the decoder never
+/// sees half a frame. Dropped frames still use up their sequence number. Only call from
+/// fibers, which do not interrupt each other while a frame is built.
+/// @tparam Uart A modm::platform::BufferedUart with a transmit buffer.
+/// @tparam Capacity The largest payload.
+template <typename Uart, size_t Capacity = 256>
+class telemetry_link
+{
+public:
+    using frame_type = telemetry_frame<Capacity>;
+
+    /// @brief Sends a single record stamped with the current time.
+    template <typename Record>
+    static bool send(const Record &record)
+    {
+        begin(Record::type).append(record);
+        return transmit();
+    }
+
+    /// @brief Starts a frame stamped with the current time, to append a payload of several parts.
+    static frame_type &begin(const telemetry_type type)
+    {
+        frame.begin(type, sequence, static_cast<uint32_t>(modm::PreciseClock::now().time_since_epoch().count()));
+        return frame;
+    }
+
+    /// @brief Sends the frame started by begin().
+    /// @return False if it was dropped.
+    static bool transmit()
+    {
+        ++sequence;
+        const auto bytes = frame.finish();
+        if (bytes.empty() or Uart::TxBufferSize - Uart::transmitBufferSize() < bytes.size())
+        {
+            ++frames_dropped;
+            return false;
+        }
+        Uart::write(bytes.data(), bytes.size());
+        ++frames_sent;
+        return true;
+    }
+
+    static uint32_t sent() { return frames_sent; }
+    static uint32_t dropped() { return frames_dropped; }
+
+private:
+    static inline frame_type frame;
+    static inline uint16_t sequence = 0;
+    static inline uint32_t frames_sent = 0;
+    static inline uint32_t frames_dropped = 0;
+};
@@ -0,0 +1,398 @@
+// Host simulation of the parallel refresh of the expansion chains, see expansion/chain_group.hpp.
+//
+// Every chain of the compiled layout gets a simulated transport and shift registers, and all
+// chains share one simulated latch. The simulation writes random outputs, refreshes and checks
+// that all transfers run at the same time, that the latch only rises after every transfer
+// completed, that the outputs of all chains change with that edge only, and that the inputs
+// are taken over from complete transfers only. Then, if the last chain is looped_back, it breaks
+// that chain in several ways and checks that the loopback check reports each of them. It is built
+// against the generated headers, a description with "loopback": true on the last chain checks
+// the loopback as well. tools/CMakeLists.txt also builds it against tools/sensor_layout.json as
+// chainsim_sensors for that:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target chainsim
+//
+//   chainsim [refreshes]
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "expansion/chain_group.hpp"
+
+namespace
+{
+    constexpr size_t chains = expansion_chains::count;
+
+    /// @brief Duration of one byte on a bus, in simulated ticks.
+    constexpr uint64_t byte_time = 8;
+
+    std::vector<std::string> errors;
+    std::mt19937 random_generator(1);
+
+    template <typename... Args>
+    void fail(const char *format, Args... args)
+    {
+        char message[160];
+        std::snprintf(message, sizeof(message), format, args...);
+        errors.emplace_back(message);
+    }
+
+    /// @brief The shift registers of a chain and what the boards see.
+    /// @details The size of inputs is the actual length of the chain.
+    struct simulated_chain
+    {
+        std::vector<uint8_t> shift;
+        std::vector<uint8_t> outputs;
+        std::vector<uint8_t> inputs;
+        const uint8_t *tx = nullptr;
+        uint8_t *rx = nullptr;
+        size_t length = 0;
+        bool busy = false;
+        bool fail_next = false;
+        uint64_t started = 0;
+
+        /// @brief Bits stuck high on MISO.
+        uint8_t stuck_high = 0;
+
+        /// @brief MISO is disconnected and pulled high.
+        bool broken = false;
+    };
+
+    std::array<simulated_chain, chains> simulated;
+    bool latched = true;
+    uint64_t now = 0;
+    uint64_t refresh_end = 0;
+
+    struct simulated_latch
+    {
+        /// @brief The boards load their inputs into the shift registers.
+        static void reset()
+        {
+            if (not latched)
+            {
+                fail("latch falls twice");
+            }
+            latched = false;
+            for (auto &chain : simulated)
+            {
+                chain.shift = chain.inputs;
+            }
+        }
+
+        /// @brief The boards take over the shift registers as outputs.
+        static void set()
+        {
+            if (latched)
+            {
+                fail("latch rises twice");
+            }
+            for (size_t i = 0; i < chains; ++i)
+            {
+                if (simulated[i].busy)
+                {
+                    fail("latch rises while chain %zu transfers", i);
+                }
+                simulated[i].outputs = simulated[i].shift;
+            }
+            latched = true;
+        }
+    };
+
+    template <size_t I>
+    struct simulated_transport
+    {
+        static void start(const uint8_t *tx, uint8_t *rx, const size_t length)
+        {
+            auto &chain = simulated[I];
+            if (latched or chain.busy)
+            {
+                fail("chain %zu starts outside of a refresh", I);
+            }
+            chain.tx = tx;
+            chain.rx = rx;
+            chain.length = length;
+            chain.busy = true;
+            chain.started = now;
+        }
+
+        /// @brief Completes the transfer, which ran since start() in parallel with the others.
+        static bool wait()
+        {
+            auto &chain = simulated[I];
+            if (not chain.busy)
+            {
+                fail("chain %zu waits without a transfer", I);
+                return false;
+            }
+            chain.busy = false;
+            refresh_end = std::max(refresh_end, chain.started + chain.length * byte_time);
+
+            // The registers shift out their contents followed by the frame and keep its end,
+            // an aborted transfer stops after half of the frame
+            const bool abort = std::exchange(chain.fail_next, false);
+            const size_t shifted = abort ? chain.length / 2 : chain.length;
+            std::vector<uint8_t> stream = chain.shift;
+            stream.insert(stream.end(), chain.tx, chain.tx + shifted);
+            for (size_t i = 0; i < shifted; ++i)
+            {
+                chain.rx[i] = chain.broken ? 0xff : stream[i] | chain.stuck_high;
+            }
+            chain.shift.assign(stream.end() - static_cast<ptrdiff_t>(chain.shift.size()), stream.end());
+            return not abort;
+        }
+    };
+
+    template <size_t... I>
+    chain_group<simulated_latch, simulated_transport<I>...> make_group(std::index_sequence<I...>);
+
+    using group_type = decltype(make_group(std::make_index_sequence<chains>{}));
+
+    group_type group;
+
+    /// @brief Every output of a chain and its expected state.
+    struct output
+    {
+        output_bit bit;
+        bool state;
+    };
+
+    template <size_t I>
+    std::vector<output> outputs_of()
+    {
+        using chain_type = typename expansion_chains::template chain<I>;
+        std::vector<output> result;
+        for (size_t board = 0; board < chain_type::board_count; ++board)
+        {
+            for (size_t bit = 0; bit < chain_type::boards[board].outputs * 8; ++bit)
+            {
+                const ioposition pos{board, static_cast<uint8_t>(bit), static_cast<uint8_t>(I)};
+                result.push_back({resolve_output(pos), false});
+            }
+        }
+        return result;
+    }
+
+    template <size_t I>
+    void check_chain(const std::vector<output> &expected, const std::vector<uint8_t> &before, const bool changed)
+    {
+        const auto &chain = simulated[I];
+        for (const auto &out : expected)
+        {
+            const bool state = chain.outputs[out.bit.index] & out.bit.mask;
+            if (changed and state != out.state)
+            {
+                fail("chain %zu: output %u/%u is %d after the latch", I, out.bit.index, out.bit.mask, state);
+            }
+        }
+        if (not changed and chain.outputs != before)
+        {
+            fail("chain %zu: outputs changed without a refresh", I);
+        }
+        const auto &io = group.template chain<I>();
+        for (size_t i = 0; i < io.buffer_size; ++i)
+        {
+            const uint8_t mask = expansion_chains::template chain<I>::input_mask[i];
+            if ((io.in_buffer[i] & mask) != (chain.inputs[i] & mask))
+            {
+                fail("chain %zu: input byte %zu is %02x instead of %02x", I, i, io.in_buffer[i] & mask, chain.inputs[i] & mask);
+            }
+        }
+    }
+
+    /// @brief Breaks the last chain in one way and checks the report of the loopback check.
+    void check_fault(const char *name, const integrity_status status, const int16_t length_error, const uint8_t stuck_high)
+    {
+        constexpr size_t last = chains - 1;
+        const auto &report = group.integrity(last);
+        const auto threshold = group.template chain<last>().loopback.fault_threshold;
+        for (size_t n = 1; n <= threshold; ++n)
+        {
+            group.refresh();
+            const auto faults = group.take_faults();
+            if (faults != (n == threshold ? 1u << last : 0u))
+            {
+                fail("%s: faults %x after %zu refreshes", name, faults, n);
+            }
+        }
+        if (report.status != status or not report.fault or report.length_error != length_error)
+        {
+            fail("%s: status %d, length error %d, fault %d", name, int(report.status), report.length_error, report.fault);
+        }
+        // The stuck MISO bit shows up in those bytes of the pattern in which it was low
+        if (stuck_high != 0 and (report.stuck_high == 0 or report.stuck_high & ~(0x0101'0101u * stuck_high)))
+        {
+            fail("%s: stuck high %08x", name, report.stuck_high);
+        }
+        group.refresh();
+        if (group.take_faults() != 0)
+        {
+            fail("%s: fault reported twice", name);
+        }
+    }
+
+    void check_integrity()
+    {
+        constexpr size_t last = chains - 1;
+        auto &chain = simulated[last];
+        const auto length = chain.inputs.size();
+        const auto repair = [&]
+        {
+            chain.inputs.assign(length, 0);
+            chain.shift = chain.inputs;
+            chain.stuck_high = 0;
+            chain.broken = false;
+            group.clear_fault(last);
+            group.refresh();
+            if (group.integrity(last).status != integrity_status::OK)
+            {
+                fail("repaired chain reports %d", int(group.integrity(last).status));
+            }
+        };
+
+        chain.inputs.resize(length - 1);
+        chain.shift = chain.inputs;
+        check_fault("board missing", integrity_status::LENGTH_MISMATCH, -1, 0);
+        repair();
+
+        chain.inputs.resize(length + 2);
+        chain.shift = chain.inputs;
+        check_fault("two bytes too long", integrity_status::LENGTH_MISMATCH, 2, 0);
+        repair();
+
+        chain.stuck_high = 0x10;
+        check_fault("stuck bit", integrity_status::STUCK_BITS, 0, 0x10);
+        repair();
+
+        chain.broken = true;
+        check_fault("broken cable", integrity_status::NO_LOOPBACK, 0, 0);
+        repair();
+    }
+
+    int run(const size_t refreshes)
+    {
+        std::array<std::vector<output>, chains> expected;
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { ((expected[I] = outputs_of<I>(),
+            simulated[I].shift.assign(group.template chain<I>().buffer_size, 0),
+            simulated[I].outputs = simulated[I].shift,
+            simulated[I].inputs = simulated[I].shift),
+           ...); }(std::make_index_sequence<chains>{});
+
+        uint64_t parallel = 0;
+        uint64_t sequential = 0;
+        size_t failures = 0;
+        for (size_t n = 0; n < refreshes; ++n)
+        {
+            // Random writes on all chains, with the outputs of the boards checked while writing
+            const auto before = [&]
+            {
+                std::array<std::vector<uint8_t>, chains> result;
+                for (size_t i = 0; i < chains; ++i)
+                {
+                    result[i] = simulated[i].outputs;
+                }
+                return result;
+            }();
+            for (auto &chain : expected)
+            {
+                for (auto &out : chain)
+                {
+                    if (random_generator() % 4 == 0)
+                    {
+                        out.state = random_generator() % 2;
+                        group.set_output(out.bit, out.state);
+                    }
+                }
+            }
+            [&]<size_t... I>(std::index_sequence<I...>)
+            { (check_chain<I>(expected[I], before[I], false), ...); }(std::make_index_sequence<chains>{});
+
+            // New inputs, which the boards load with the next refresh
+            for (auto &chain : simulated)
+            {
+                for (auto &byte : chain.inputs)
+                {
+                    byte = static_cast<uint8_t>(random_generator());
+                }
+            }
+
+            // Every tenth refresh one chain fails and is repeated with the next refresh
+            const bool inject = n % 10 == 9;
+            const size_t failing = random_generator() % chains;
+            simulated[failing].fail_next = inject;
+            const auto inputs = group.template chain<0>().in_buffer;
+
+            group.publish();
+            refresh_end = now;
+            const auto failed = group.refresh();
+            parallel += refresh_end - now;
+            for (const auto &chain : simulated)
+            {
+                sequential += chain.length * byte_time;
+            }
+            now = refresh_end + 1;
+            if (not latched)
+            {
+                fail("refresh %zu: latch stays low", n);
+            }
+            if (inject)
+            {
+                ++failures;
+                if (failed != 1u << failing)
+                {
+                    fail("refresh %zu: chain %zu failed, reported mask %x", n, failing, failed);
+                }
+                if (failing == 0 and group.template chain<0>().in_buffer != inputs)
+                {
+                    fail("refresh %zu: inputs taken over from a failed transfer", n);
+                }
+                // The front buffers still hold the frame, the next refresh repeats it
+                if (group.refresh() != 0)
+                {
+                    fail("refresh %zu: repeated refresh failed", n);
+                }
+            }
+            else if (failed != 0)
+            {
+                fail("refresh %zu: chains %x failed", n, failed);
+            }
+            [&]<size_t... I>(std::index_sequence<I...>)
+            { (check_chain<I>(expected[I], before[I], true), ...); }(std::make_index_sequence<chains>{});
+
+            if (errors.size() > 20)
+            {
+                break;
+            }
+        }
+
+        constexpr bool checked = chain_io<chains - 1>::checked;
+        if constexpr (checked)
+        {
+            check_integrity();
+        }
+
+        for (const auto &error : errors)
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+        }
+        if (not errors.empty())
+        {
+            return 1;
+        }
+        std::printf("%zu chains, %zu refreshes, %zu failed transfers recovered\n", chains, refreshes, failures);
+        std::printf("refresh time %.1f ticks in parallel, %.1f ticks one chain after the other\n",
+                    double(parallel) / double(refreshes), double(sequential) / double(refreshes));
+        std::printf(checked ? "loopback faults reported\n" : "loopback check off for the last chain, not tested\n");
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t refreshes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    return run(refreshes == 0 ? 1 : refreshes);
+}
@@ -0,0 +1,136 @@
+// Host check of the DCC packet encoder, see dcc/encoder.hpp.
+//
+// Encodes packets and compares the half bits with reference bit streams, written out by hand
+// from the packet format of NMRA S-9.2, and checks the packet builders and the rejected input:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target dcccheck
+
+#include <array>
+#include <cstdio>
+#include <string>
+#include "dcc/encoder.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void expect(const bool condition, const char *what, const int line)
+    {
+        if (not condition)
+        {
+            std::printf("FAIL line %d: %s\n", line, what);
+            ++failures;
+        }
+    }
+#define EXPECT(condition) expect(condition, #condition, __LINE__)
+
+    /// @brief The bits of encoded half bits, 'x' for a half bit pair which is no valid bit.
+    std::string bits_of(const uint16_t *half_bits, const size_t count, const dcc_timing &timing = {})
+    {
+        std::string bits;
+        for (size_t i = 0; i + 1 < count; i += 2)
+        {
+            if (half_bits[i] != half_bits[i + 1])
+            {
+                bits += 'x';
+            }
+            else
+            {
+                bits += half_bits[i] == timing.one ? '1' : half_bits[i] == timing.zero ? '0' : 'x';
+            }
+        }
+        return bits;
+    }
+
+    /// @brief The reference without the spaces which separate its fields.
+    std::string reference(const char *stream)
+    {
+        std::string bits;
+        for (; *stream; ++stream)
+        {
+            if (*stream != ' ')
+            {
+                bits += *stream;
+            }
+        }
+        return bits;
+    }
+
+    std::string encode(const dcc_packet &packet, const size_t preamble = 16)
+    {
+        std::array<uint16_t, dcc_max_encoded_size(20)> half_bits{};
+        const auto count = dcc_encode(packet, half_bits, preamble);
+        EXPECT(count == dcc_encoded_size(packet, preamble));
+        return bits_of(half_bits.data(), count);
+    }
+
+    void reference_streams()
+    {
+        // The examples of S-9.2 with the shortest preamble
+        EXPECT(encode(dcc_packet::idle(), 14) == reference("11111111111111 0 11111111 0 00000000 0 11111111 1"));
+        EXPECT(encode({{0x37, 0x74}, 2}, 14) == reference("11111111111111 0 00110111 0 01110100 0 01000011 1"));
+
+        EXPECT(encode(dcc_packet::reset()) == reference("1111111111111111 0 00000000 0 00000000 0 00000000 1"));
+        // 128 speed steps, address 3 forward with step 20 sends 21
+        EXPECT(encode(dcc_packet::speed(3, true, 20)) ==
+               reference("1111111111111111 0 00000011 0 00111111 0 10010101 0 10101001 1"));
+        // Long address 1000 is 0xc3e8, backwards with step 10
+        EXPECT(encode(dcc_packet::speed(1000, false, 10)) ==
+               reference("1111111111111111 0 11000011 0 11101000 0 00111111 0 00001011 0 00011111 1"));
+        EXPECT(encode(dcc_packet::emergency_stop(3, false)) ==
+               reference("1111111111111111 0 00000011 0 00111111 0 00000001 0 00111101 1"));
+        EXPECT(encode(dcc_packet::speed(3, true, 0)) ==
+               reference("1111111111111111 0 00000011 0 00111111 0 10000000 0 10111100 1"));
+    }
+
+    void durations()
+    {
+        const dcc_timing stretched{.one = 56, .zero = 120};
+        std::array<uint16_t, dcc_max_encoded_size()> half_bits{};
+        const auto count = dcc_encode(dcc_packet::idle(), half_bits, 16, stretched);
+        EXPECT(count == 2 * (16 + 27 + 1));
+        EXPECT(half_bits[0] == 56 and half_bits[31] == 56);
+        EXPECT(half_bits[32] == 120 and half_bits[33] == 120);
+        EXPECT(bits_of(half_bits.data(), count, stretched) ==
+               reference("1111111111111111 0 11111111 0 00000000 0 11111111 1"));
+
+        const dcc_packet longest{{0xc3, 0xe8, 0xde, 0x01, 0x02}, dcc_packet::max_bytes};
+        EXPECT(dcc_encode(longest, half_bits) == half_bits.size());
+    }
+
+    void rejected()
+    {
+        std::array<uint16_t, dcc_max_encoded_size()> half_bits{};
+        EXPECT(dcc_encode({{0xff}, 1}, half_bits) == 0);
+        EXPECT(dcc_encode({}, half_bits) == 0);
+        EXPECT(dcc_encode(dcc_packet::idle(), half_bits, 13) == 0);
+        EXPECT(dcc_encode(dcc_packet::idle(), std::span(half_bits).first(dcc_encoded_size(dcc_packet::idle()) - 1)) == 0);
+
+        EXPECT(dcc_packet::speed(0, true, 1).length == 0);
+        EXPECT(dcc_packet::speed(dcc_packet::max_address + 1, true, 1).length == 0);
+        EXPECT(dcc_packet::speed(3, true, 127).length == 0);
+        EXPECT(dcc_packet::speed(127, true, 1).length == 3);
+        EXPECT(dcc_packet::speed(128, true, 1).length == 4);
+        EXPECT(dcc_packet::speed(dcc_packet::max_address, true, 126).bytes[0] == 0xe7);
+    }
+
+    // The encoder runs at compile time as well
+    static_assert([]
+                  {
+                      std::array<uint16_t, dcc_max_encoded_size()> half_bits{};
+                      return dcc_encode(dcc_packet::idle(), half_bits);
+                  }() == 88);
+}
+
+int main()
+{
+    reference_streams();
+    durations();
+    rejected();
+    if (failures)
+    {
+        return 1;
+    }
+    std::printf("DCC encoding matches the reference bit streams\n");
+    return 0;
+}
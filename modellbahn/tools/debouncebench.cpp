@@ -0,0 +1,199 @@
+// Host check and benchmark of the input debouncer, see expansion/debouncer.hpp.
+//
+// Feeds random bouncing inputs to the debouncer and to a naive reference which keeps one
+// counter per input and handles one bit after the other, and compares the debounced state and
+// the rising and falling edges after every sample. This runs for every sample count of the
+// default and of a wider counter, including counts outside of the range which are clamped. Then
+// both are timed over a few thousand inputs:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target debouncebench
+//
+//   debouncebench [seed]
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "expansion/debouncer.hpp"
+
+namespace
+{
+    std::mt19937 random_generator;
+    int failures = 0;
+
+    template <typename... Args>
+    void fail(const char *format, Args... args)
+    {
+        // The first few failures tell enough, a broken counter fails on most samples
+        if (++failures <= 10)
+        {
+            std::printf(format, args...);
+        }
+    }
+
+    /// @brief One counter per input, the straightforward way.
+    template <size_t Bytes>
+    struct naive_debouncer
+    {
+        uint32_t samples;
+        std::array<uint8_t, Bytes * 8> counter{};
+        std::array<bool, Bytes * 8> state{};
+        std::array<bool, Bytes * 8> rising{};
+        std::array<bool, Bytes * 8> falling{};
+
+        void update(const uint8_t *inputs)
+        {
+            for (size_t i = 0; i < Bytes * 8; ++i)
+            {
+                const bool sample = inputs[i / 8] & (1 << (i % 8));
+                rising[i] = false;
+                falling[i] = false;
+                if (sample == state[i])
+                {
+                    counter[i] = 0;
+                }
+                else if (++counter[i] == samples)
+                {
+                    counter[i] = 0;
+                    state[i] = sample;
+                    rising[i] = sample;
+                    falling[i] = not sample;
+                }
+            }
+        }
+    };
+
+    /// @brief Inputs which change now and then and bounce for a few samples after each change.
+    template <size_t Bytes>
+    struct bouncing_inputs
+    {
+        std::array<bool, Bytes * 8> level{};
+        std::array<uint8_t, Bytes * 8> bouncing{};
+        std::array<uint8_t, Bytes> sample{};
+
+        const uint8_t *next()
+        {
+            std::uniform_int_distribution<int> event(0, 199);
+            std::uniform_int_distribution<int> bounce(1, 12);
+            sample.fill(0);
+            for (size_t i = 0; i < Bytes * 8; ++i)
+            {
+                const auto e = event(random_generator);
+                if (e == 0)
+                {
+                    level[i] = not level[i];
+                    bouncing[i] = static_cast<uint8_t>(bounce(random_generator));
+                }
+                bool value = level[i];
+                if (bouncing[i] != 0)
+                {
+                    --bouncing[i];
+                    value = random_generator() & 1;
+                }
+                else if (e == 1)
+                {
+                    // A single glitch
+                    value = not value;
+                }
+                if (value)
+                {
+                    sample[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+                }
+            }
+            return sample.data();
+        }
+    };
+
+    template <size_t Bytes, size_t CounterBits>
+    void compare(const uint32_t samples, const size_t steps)
+    {
+        using debouncer_type = debouncer<Bytes, CounterBits>;
+        debouncer_type tested(samples);
+        const auto expected_samples = samples < 1 ? 1 : samples > debouncer_type::max_samples ? debouncer_type::max_samples : samples;
+        if (tested.samples() != expected_samples)
+        {
+            fail("FAIL %u samples are set as %u\n", samples, tested.samples());
+        }
+        naive_debouncer<Bytes> reference{.samples = expected_samples};
+        bouncing_inputs<Bytes> inputs;
+        for (size_t step = 0; step < steps; ++step)
+        {
+            const auto *const sample = inputs.next();
+            tested.update(sample);
+            reference.update(sample);
+            for (size_t i = 0; i < Bytes * 8; ++i)
+            {
+                const auto word = i / 32;
+                const auto mask = uint32_t(1) << (i % 32);
+                const input_bit bit{.index = static_cast<uint16_t>(i / 8), .mask = static_cast<uint8_t>(1 << (i % 8)), .chain = 0};
+                if (tested.test(bit) != reference.state[i] or bool(tested.state()[word] & mask) != reference.state[i] or
+                    bool(tested.rising()[word] & mask) != reference.rising[i] or bool(tested.falling()[word] & mask) != reference.falling[i])
+                {
+                    fail("FAIL %zu counter bits, %u samples: input %zu differs at step %zu\n", CounterBits, samples, i, step);
+                    return;
+                }
+            }
+        }
+    }
+
+    template <typename Debouncer>
+    double time_updates(Debouncer &debouncer, const std::vector<std::vector<uint8_t>> &samples, const size_t rounds)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (const auto &sample : samples)
+            {
+                debouncer.update(sample.data());
+            }
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / double(rounds * samples.size());
+    }
+
+    void benchmark()
+    {
+        constexpr size_t bytes = 512;
+        bouncing_inputs<bytes> inputs;
+        std::vector<std::vector<uint8_t>> samples;
+        for (size_t i = 0; i < 64; ++i)
+        {
+            const auto *const sample = inputs.next();
+            samples.emplace_back(sample, sample + bytes);
+        }
+        debouncer<bytes> vertical(4);
+        naive_debouncer<bytes> naive{.samples = 4};
+        const auto vertical_time = time_updates(vertical, samples, 2000);
+        const auto naive_time = time_updates(naive, samples, 200);
+        // Keep the results alive
+        if (vertical.state()[0] == 0x12345678 and naive.state[0])
+        {
+            std::printf(" ");
+        }
+        std::printf("%zu inputs: vertical counters %.0f ns per update (%.2f ns per 32 inputs), naive %.0f ns per update\n",
+                    bytes * 8, vertical_time, vertical_time / (bytes / 4), naive_time);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    random_generator.seed(argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 1);
+    for (uint32_t samples = 0; samples <= 8; ++samples)
+    {
+        compare<61, 3>(samples, 3000);
+    }
+    for (const uint32_t samples : {1u, 5u, 9u, 15u, 20u})
+    {
+        compare<64, 4>(samples, 3000);
+    }
+    if (failures)
+    {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    benchmark();
+    std::printf("The debouncer matches the naive reference\n");
+    return 0;
+}
@@ -0,0 +1,301 @@
+// Host check of the double-buffered refresh, see expansion/double_buffer.hpp.
+//
+// Replaces the SPI and DMA pair of every chain with a mock which moves one byte per step and
+// lets the application write random outputs between the steps, the way other fibers and
+// interrupts do while the refresh of the controller sleeps in wait(). The mock records the bytes
+// on the wire as they are read from the front buffer and shifts them through simulated
+// registers into the receive buffer. For every frame the check compares the wire with the
+// outputs written up to the publish() of that refresh, so a write which reaches a running
+// transfer shows up as a torn frame. It also checks that start() returns before the first byte
+// moved, that writes made during a transfer are sent with the next frame, that a refresh without
+// writes publishes nothing and repeats the frame, and that the latch only rises once all
+// transfers completed. It is built against the generated headers by tools/CMakeLists.txt:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target dmacheck
+//
+//   dmacheck [refreshes]
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+#include "expansion/chain_group.hpp"
+
+namespace
+{
+    constexpr size_t chains = expansion_chains::count;
+
+    std::mt19937 random_generator(1);
+    int failures = 0;
+
+    template <typename... Args>
+    void fail(const char *format, Args... args)
+    {
+        // The first few failures tell enough, a torn frame shows up in every refresh
+        if (++failures <= 10)
+        {
+            std::printf(format, args...);
+        }
+    }
+
+    /// @brief A DMA transfer in progress and the registers of the chain it shifts through.
+    struct mock_channel
+    {
+        const uint8_t *tx = nullptr;
+        uint8_t *rx = nullptr;
+        size_t length = 0;
+        size_t position = 0;
+        bool busy = false;
+
+        /// @brief The bytes sent so far, read from tx one step after the other.
+        std::vector<uint8_t> wire;
+
+        /// @brief The shift registers of the boards.
+        std::vector<uint8_t> shift;
+    };
+
+    std::array<mock_channel, chains> channels;
+    bool latched = true;
+
+    /// @brief Called between two steps of the transfers, stands in for the other fibers.
+    void (*concurrent_writes)() = nullptr;
+
+    struct mock_latch
+    {
+        static void reset()
+        {
+            if (not latched)
+            {
+                fail("FAIL the latch falls twice\n");
+            }
+            latched = false;
+        }
+
+        static void set()
+        {
+            for (size_t i = 0; i < chains; ++i)
+            {
+                if (channels[i].busy)
+                {
+                    fail("FAIL the latch rises while chain %zu transfers\n", i);
+                }
+            }
+            latched = true;
+        }
+    };
+
+    /// @brief Moves one byte of a transfer, the registers return what they held before.
+    void step(mock_channel &channel)
+    {
+        const auto byte = channel.tx[channel.position];
+        channel.wire.push_back(byte);
+        const auto registers = channel.shift.size();
+        channel.rx[channel.position] = channel.position < registers ? channel.shift[channel.position] : channel.wire[channel.position - registers];
+        if (++channel.position == channel.length)
+        {
+            // The registers keep the end of the stream
+            std::vector<uint8_t> stream = channel.shift;
+            stream.insert(stream.end(), channel.wire.begin(), channel.wire.end());
+            channel.shift.assign(stream.end() - static_cast<ptrdiff_t>(registers), stream.end());
+            channel.busy = false;
+        }
+    }
+
+    /// @brief The SPI and DMA pair of a chain, same interface as spi_dma_transport.
+    template <size_t I>
+    struct mock_transport
+    {
+        static void start(const uint8_t *tx, uint8_t *rx, const size_t length)
+        {
+            auto &channel = channels[I];
+            if (channel.busy or latched)
+            {
+                fail("FAIL chain %zu starts outside of a refresh\n", I);
+            }
+            channel.tx = tx;
+            channel.rx = rx;
+            channel.length = length;
+            channel.position = 0;
+            channel.wire.clear();
+            channel.busy = true;
+        }
+
+        static bool is_busy() { return channels[I].busy; }
+
+        /// @brief The fiber sleeps until the transfer completed, the application keeps writing.
+        static bool wait()
+        {
+            auto &channel = channels[I];
+            while (channel.busy)
+            {
+                // All transfers run at the same time
+                for (auto &other : channels)
+                {
+                    if (other.busy)
+                    {
+                        step(other);
+                    }
+                }
+                if (concurrent_writes)
+                {
+                    concurrent_writes();
+                }
+            }
+            return true;
+        }
+    };
+
+    template <size_t... I>
+    chain_group<mock_latch, mock_transport<I>...> make_group(std::index_sequence<I...>);
+
+    using group_type = decltype(make_group(std::make_index_sequence<chains>{}));
+
+    group_type group;
+
+    /// @brief The outputs of all chains as the application last wrote them.
+    std::array<std::vector<uint8_t>, chains> written;
+
+    /// @brief Every output of the expansion.
+    std::vector<output_bit> outputs;
+
+    size_t writes_during_transfers = 0;
+
+    /// @brief Writes a few random outputs, one at a time or several at once with apply().
+    /// @return The number of outputs written.
+    size_t write_outputs()
+    {
+        const auto count = random_generator() % 4;
+        for (size_t n = 0; n < count and not outputs.empty(); ++n)
+        {
+            const auto bit = outputs[random_generator() % outputs.size()];
+            const bool state = random_generator() % 2;
+            auto &byte = written[bit.chain][bit.index];
+            byte = static_cast<uint8_t>(state ? byte | bit.mask : byte & ~bit.mask);
+            if (bit.chain == 0 and random_generator() % 2)
+            {
+                chain_io<0>::mask_type mask{};
+                mask.assign(bit, state);
+                group.chain<0>().apply(mask);
+            }
+            else
+            {
+                group.set_output(bit, state);
+            }
+        }
+        return outputs.empty() ? 0 : count;
+    }
+
+    void write_during_transfer()
+    {
+        writes_during_transfers += write_outputs();
+    }
+
+    template <size_t I>
+    void collect_outputs()
+    {
+        using chain_type = typename expansion_chains::template chain<I>;
+        written[I].assign(chain_type::buffer_size, 0);
+        for (size_t board = 0; board < chain_type::board_count; ++board)
+        {
+            for (size_t bit = 0; bit < chain_type::boards[board].outputs * 8; ++bit)
+            {
+                outputs.push_back(resolve_output({board, static_cast<uint8_t>(bit), static_cast<uint8_t>(I)}));
+            }
+        }
+        channels[I].shift.assign(chain_type::buffer_size, 0);
+    }
+
+    /// @brief Compares the frame on the wire with the outputs at the time of the publish().
+    template <size_t I>
+    void check_frame(const std::vector<uint8_t> &published, const size_t refresh)
+    {
+        using chain_type = typename expansion_chains::template chain<I>;
+        const auto &wire = channels[I].wire;
+        if (wire.size() != chain_io<I>::frame_size)
+        {
+            fail("FAIL refresh %zu: chain %zu sent %zu bytes\n", refresh, I, wire.size());
+            return;
+        }
+        for (size_t i = 0; i < chain_type::buffer_size; ++i)
+        {
+            const auto mask = chain_type::output_mask[i];
+            if ((wire[chain_io<I>::pattern_size + i] & mask) != (published[i] & mask))
+            {
+                fail("FAIL refresh %zu: chain %zu sent %02x in byte %zu instead of %02x\n", refresh, I,
+                     wire[chain_io<I>::pattern_size + i] & mask, i, published[i] & mask);
+            }
+        }
+    }
+
+    int run(const size_t refreshes)
+    {
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { (collect_outputs<I>(), ...); }(std::make_index_sequence<chains>{});
+
+        size_t repeated = 0;
+        for (size_t n = 0; n < refreshes; ++n)
+        {
+            // Some refreshes find no writes, those repeat the last frame. Nothing is written
+            // during the transfers before them either.
+            const bool quiet = n % 8 == 7;
+            const bool writes_during_transfer = n % 8 < 6;
+            if (not quiet)
+            {
+                write_outputs();
+            }
+            const bool modified = group.is_modified();
+            const auto published = written;
+            const auto writes = group.publish();
+            if ((writes != 0) != modified or (quiet and writes != 0))
+            {
+                fail("FAIL refresh %zu: %u writes published, modified %d\n", n, writes, modified);
+            }
+            repeated += writes == 0;
+
+            group.prepare();
+            group.begin_transfers();
+            for (size_t i = 0; i < chains; ++i)
+            {
+                if (channels[i].position != 0 or not channels[i].busy)
+                {
+                    fail("FAIL refresh %zu: chain %zu did not return from start() at once\n", n, i);
+                }
+            }
+            concurrent_writes = writes_during_transfer ? write_during_transfer : nullptr;
+            const auto failed = group.finish_transfers();
+            concurrent_writes = nullptr;
+            mock_latch::set();
+            if (failed != 0 or group.take_faults() != 0)
+            {
+                fail("FAIL refresh %zu: chains %x failed\n", n, failed);
+            }
+            [&]<size_t... I>(std::index_sequence<I...>)
+            { (check_frame<I>(published[I], n), ...); }(std::make_index_sequence<chains>{});
+        }
+
+        // The writes of the last transfers go out with one more frame
+        const auto published = written;
+        group.publish();
+        group.refresh();
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { (check_frame<I>(published[I], refreshes), ...); }(std::make_index_sequence<chains>{});
+
+        if (failures)
+        {
+            std::printf("%d failures\n", failures);
+            return 1;
+        }
+        std::printf("%zu chains, %zu refreshes, %zu of them repeated, %zu writes during transfers\n", chains, refreshes,
+                    repeated, writes_during_transfers);
+        std::printf("No frame was torn by a write\n");
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t refreshes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    return run(refreshes == 0 ? 1 : refreshes);
+}
@@ -0,0 +1,280 @@
+// Host check and benchmark of the fixed-point filters, see analog/filters.hpp.
+//
+// Every filter runs over random signals split into blocks of random sizes, and its output is
+// compared value by value with a straightforward per-sample reference computed in 64 bits. On
+// the host the SIMD instructions are emulated by analog/dsp.hpp, so a match shows that the
+// emulation and the kernels agree with the reference bit for bit. Then every filter is timed
+// over long blocks. Built for a Cortex-M4 the same file counts the cycles with the DWT and runs
+// the real instructions:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target filterbench
+//
+//   filterbench [seed]
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "analog/filters.hpp"
+
+namespace
+{
+    std::mt19937 random_generator;
+    int failures = 0;
+
+    /// @brief ADC-like values: noise with steps and single spikes.
+    std::vector<int16_t> signal(const size_t count, const int16_t lowest, const int16_t highest)
+    {
+        std::uniform_int_distribution<int> value(lowest, highest);
+        std::uniform_int_distribution<int> noise(-20, 20);
+        std::uniform_int_distribution<int> event(0, 99);
+        std::vector<int16_t> values(count);
+        int level = value(random_generator);
+        for (auto &v : values)
+        {
+            const auto e = event(random_generator);
+            level = e == 0 ? value(random_generator) : level;
+            const auto x = e == 1 ? value(random_generator) : level + noise(random_generator);
+            v = static_cast<int16_t>(x < lowest ? lowest : x > highest ? highest : x);
+        }
+        return values;
+    }
+
+    /// @brief Runs a filter over the values in blocks of random sizes.
+    template <typename Filter>
+    std::vector<int16_t> blocked(Filter &filter, const std::vector<int16_t> &values)
+    {
+        std::uniform_int_distribution<size_t> size(0, 37);
+        std::vector<int16_t> out(values.size() + 1);
+        size_t written = 0;
+        for (size_t i = 0; i < values.size();)
+        {
+            const auto count = std::min(size(random_generator), values.size() - i);
+            if constexpr (requires { { filter.process(values.data(), out.data(), 0) } -> std::same_as<size_t>; })
+            {
+                written += filter.process(values.data() + i, out.data() + written, count);
+            }
+            else
+            {
+                filter.process(values.data() + i, out.data() + written, count);
+                written += count;
+            }
+            i += count;
+        }
+        out.resize(written);
+        return out;
+    }
+
+    void compare(const char *name, const std::vector<int16_t> &result, const std::vector<int16_t> &reference)
+    {
+        if (result.size() != reference.size())
+        {
+            std::printf("FAIL %s: %zu values instead of %zu\n", name, result.size(), reference.size());
+            ++failures;
+            return;
+        }
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            if (result[i] != reference[i])
+            {
+                std::printf("FAIL %s: value %zu is %d instead of %d\n", name, i, result[i], reference[i]);
+                ++failures;
+                return;
+            }
+        }
+    }
+
+    int16_t divide_rounded(const int64_t sum, const int64_t divisor)
+    {
+        return static_cast<int16_t>((sum < 0 ? sum - divisor / 2 : sum + divisor / 2) / divisor);
+    }
+
+    template <size_t N>
+    std::vector<int16_t> reference_moving_average(const std::vector<int16_t> &values)
+    {
+        std::vector<int16_t> out;
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            int64_t sum = 0;
+            for (size_t j = 0; j < N and j <= i; ++j)
+            {
+                sum += values[i - j];
+            }
+            // Floor of the rounded average, like an arithmetic shift
+            out.push_back(static_cast<int16_t>((sum + int64_t(N / 2)) >> std::countr_zero(N)));
+        }
+        return out;
+    }
+
+    std::vector<int16_t> reference_ema(const std::vector<int16_t> &values, const int shift)
+    {
+        std::vector<int16_t> out;
+        int64_t state = 0;
+        for (const auto v : values)
+        {
+            state += (v * int64_t(65536) - state) >> shift;
+            out.push_back(static_cast<int16_t>((state + 0x8000) >> 16));
+        }
+        return out;
+    }
+
+    std::vector<int16_t> reference_biquad(const std::vector<int16_t> &values, const biquad::coefficients &c)
+    {
+        std::vector<int16_t> out;
+        int64_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+        for (const auto v : values)
+        {
+            const int64_t sum = (1 << 13) + c.b0 * int64_t(v) + c.b1 * x1 + c.b2 * x2 - c.a1 * y1 - c.a2 * y2;
+            // The accumulator of the hardware wraps at 32 bits
+            const auto wrapped = static_cast<int32_t>(static_cast<uint32_t>(sum));
+            const auto y = std::clamp<int32_t>(wrapped >> 14, INT16_MIN, INT16_MAX);
+            x2 = x1;
+            x1 = v;
+            y2 = y1;
+            y1 = y;
+            out.push_back(static_cast<int16_t>(y));
+        }
+        return out;
+    }
+
+    template <size_t N>
+    std::vector<int16_t> reference_median(const std::vector<int16_t> &values)
+    {
+        std::vector<int16_t> out;
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            std::array<int16_t, N> window;
+            for (size_t j = 0; j < N; ++j)
+            {
+                window[j] = values[i >= j ? i - j : 0];
+            }
+            std::nth_element(window.begin(), window.begin() + N / 2, window.end());
+            out.push_back(window[N / 2]);
+        }
+        return out;
+    }
+
+    template <size_t Factor>
+    std::vector<int16_t> reference_decimator(const std::vector<int16_t> &values)
+    {
+        std::vector<int16_t> out;
+        for (size_t i = 0; i + Factor <= values.size(); i += Factor)
+        {
+            int64_t sum = 0;
+            for (size_t j = 0; j < Factor; ++j)
+            {
+                sum += values[i + j];
+            }
+            out.push_back(divide_rounded(sum, Factor));
+        }
+        return out;
+    }
+
+    void check()
+    {
+        for (int round = 0; round < 20; ++round)
+        {
+            const auto adc = signal(4000, 0, 4095);
+            const auto wide = signal(4000, -16383, 16383);
+            const auto full = signal(4000, INT16_MIN, INT16_MAX);
+
+            moving_average<16> average16;
+            compare("moving_average<16>", blocked(average16, adc), reference_moving_average<16>(adc));
+            moving_average<2> average2;
+            compare("moving_average<2> wide", blocked(average2, wide), reference_moving_average<2>(wide));
+
+            ema_filter ema(4);
+            compare("ema_filter", blocked(ema, full), reference_ema(full, 4));
+
+            constexpr auto lowpass = biquad::from_float(0.0675, 0.1349, 0.0675, -1.1430, 0.4128);
+            biquad filter(lowpass);
+            compare("biquad", blocked(filter, adc), reference_biquad(adc, lowpass));
+            // Large gains overflow the accumulator, which must wrap like the hardware
+            constexpr biquad::coefficients loud{32767, -32767, 32767, -32767, 32767};
+            biquad overflowing(loud);
+            compare("biquad overflow", blocked(overflowing, full), reference_biquad(full, loud));
+
+            median_filter<5> median;
+            compare("median_filter<5>", blocked(median, full), reference_median<5>(full));
+
+            decimator<8> decimate8;
+            compare("decimator<8>", blocked(decimate8, full), reference_decimator<8>(full));
+            decimator<5> decimate5;
+            compare("decimator<5>", blocked(decimate5, full), reference_decimator<5>(full));
+        }
+    }
+
+#if MODELLBAHN_DSP_SIMD
+    const char *const unit = "cycles";
+
+    uint32_t now()
+    {
+        return DWT->CYCCNT;
+    }
+
+    void start_counter()
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+#else
+    const char *const unit = "ns";
+
+    uint32_t now()
+    {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void start_counter() {}
+#endif
+
+    /// @brief Prints the time per value of a filter over blocks of the size of a stream read.
+    template <typename Filter>
+    void benchmark(const char *name, Filter filter, const std::vector<int16_t> &values)
+    {
+        constexpr size_t block = 256;
+        std::vector<int16_t> out(block);
+        uint32_t best = UINT32_MAX;
+        for (int repeat = 0; repeat < 20; ++repeat)
+        {
+            const auto begin = now();
+            for (size_t i = 0; i + block <= values.size(); i += block)
+            {
+                filter.process(values.data() + i, out.data(), block);
+            }
+            const auto elapsed = now() - begin;
+            best = elapsed < best ? elapsed : best;
+            // Keep the output alive
+            if (out[0] == INT16_MIN and out[1] == INT16_MAX)
+            {
+                std::printf(" ");
+            }
+        }
+        std::printf("%-20s %8.2f %s per value\n", name, double(best) / double(values.size() / block * block), unit);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    random_generator.seed(argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 1);
+    check();
+    if (failures)
+    {
+        return 1;
+    }
+    std::printf("All filters match their references\n");
+
+    start_counter();
+    const auto adc = signal(8192, 0, 4095);
+    benchmark("moving_average<16>", moving_average<16>{}, adc);
+    benchmark("ema_filter", ema_filter{4}, adc);
+    benchmark("biquad", biquad{biquad::from_float(0.0675, 0.1349, 0.0675, -1.1430, 0.4128)}, adc);
+    benchmark("median_filter<5>", median_filter<5>{}, adc);
+    benchmark("decimator<8>", decimator<8>{}, adc);
+    return 0;
+}
@@ -0,0 +1,279 @@
+// Host stress test and benchmark of the interlocking, see track/interlocking.hpp.
+//
+// Sets, locks and releases random routes between the blocks and compares every result with a
+// naive reference which keeps the list of tracks of each route that is set and checks a new
+// route against all of them track by track. After every operation the reserved and locked
+// tracks and the switches of the set routes are compared as well. Then both are timed over the
+// same random requests. It is built against the generated headers, so tools/routebench.py can
+// generate large synthetic layouts for it too:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target interlockbench
+//
+//   interlockbench [seed]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "track/interlocking.hpp"
+#include "track/layout_routes.hpp"
+
+namespace
+{
+    constexpr size_t N = track_table.size();
+    constexpr size_t max_routes = 8;
+    using interlocking_type = interlocking<N, max_routes>;
+
+    std::mt19937 random_generator;
+    int failures = 0;
+
+    void expect(const bool condition, const char *what, const int line)
+    {
+        // The first few failures tell enough, a broken interlocking fails on every operation
+        if (not condition and ++failures <= 10)
+        {
+            std::printf("FAIL line %d: %s\n", line, what);
+        }
+    }
+#define EXPECT(condition) expect(condition, #condition, __LINE__)
+
+    /// @brief A random request: an arrival at a block and a destination block.
+    struct request
+    {
+        arrival source;
+        trackid destination;
+    };
+
+    /// @brief The interlocking the way it would be written without the footprints: a list of
+    /// the tracks and switch settings of every route that is set.
+    struct naive_interlocking
+    {
+        struct entry
+        {
+            std::vector<trackid> tracks;
+            std::vector<std::pair<trackid, switch_state>> settings;
+            bool locked = false;
+        };
+
+        std::vector<entry> set_routes = std::vector<entry>(max_routes);
+        std::vector<bool> used = std::vector<bool>(max_routes);
+
+        static bool walk(const request r, entry &result)
+        {
+            result = {};
+            const auto length = routes.route(r.source, r.destination, [&result](const trackid id, const switch_state state)
+                                             {
+                                                 result.tracks.push_back(id);
+                                                 if (state != switch_state::UNKNOWN)
+                                                 {
+                                                     result.settings.emplace_back(id, state);
+                                                 }
+                                             });
+            result.tracks.push_back(transition_table<N>::track_of(r.source));
+            return length != 0;
+        }
+
+        size_t set(const request r)
+        {
+            entry route;
+            if (not walk(r, route))
+            {
+                return interlocking_type::no_route;
+            }
+            for (size_t i = 0; i < max_routes; ++i)
+            {
+                if (not used[i])
+                {
+                    continue;
+                }
+                for (const auto id : set_routes[i].tracks)
+                {
+                    if (std::find(route.tracks.begin(), route.tracks.end(), id) != route.tracks.end())
+                    {
+                        return interlocking_type::no_route;
+                    }
+                }
+            }
+            const auto slot = std::find(used.begin(), used.end(), false) - used.begin();
+            if (static_cast<size_t>(slot) == max_routes)
+            {
+                return interlocking_type::no_route;
+            }
+            used[slot] = true;
+            set_routes[slot] = route;
+            return slot;
+        }
+
+        bool reserved(const trackid id, const bool only_locked) const
+        {
+            for (size_t i = 0; i < max_routes; ++i)
+            {
+                if (used[i] and (set_routes[i].locked or not only_locked) and
+                    std::find(set_routes[i].tracks.begin(), set_routes[i].tracks.end(), id) != set_routes[i].tracks.end())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    std::vector<request> random_requests(const size_t count)
+    {
+        std::vector<trackid> blocks;
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (routes.is_block(static_cast<trackid>(i)))
+            {
+                blocks.push_back(static_cast<trackid>(i));
+            }
+        }
+        std::uniform_int_distribution<size_t> pick(0, blocks.size() - 1);
+        std::uniform_int_distribution<int> via(0, 1);
+        std::vector<request> result;
+        while (result.size() < count)
+        {
+            const auto from = blocks[pick(random_generator)];
+            const auto to = blocks[pick(random_generator)];
+            if (from != to)
+            {
+                result.push_back({static_cast<arrival>(to_index(from) * 3 + via(random_generator)), to});
+            }
+        }
+        return result;
+    }
+
+    void stress(const size_t operations)
+    {
+        interlocking_type tested(routes);
+        naive_interlocking reference;
+        track_state<N> state{};
+        std::uniform_int_distribution<int> action(0, 9);
+        std::uniform_int_distribution<size_t> slot(0, max_routes);
+        size_t set = 0;
+        size_t refused = 0;
+        for (const auto r : random_requests(operations))
+        {
+            const auto a = action(random_generator);
+            if (a < 5)
+            {
+                const auto expected = reference.set(r);
+                const auto handle = tested.set(r.source, r.destination, state);
+                EXPECT(handle == expected);
+                set += handle != interlocking_type::no_route;
+                refused += handle == interlocking_type::no_route;
+            }
+            else if (a < 7)
+            {
+                const auto handle = slot(random_generator);
+                const auto was_set = handle < max_routes and reference.used[handle];
+                EXPECT(tested.lock(handle) == was_set);
+                if (was_set)
+                {
+                    reference.set_routes[handle].locked = true;
+                }
+            }
+            else
+            {
+                const auto handle = slot(random_generator);
+                const auto was_set = handle < max_routes and reference.used[handle];
+                EXPECT(tested.release(handle) == was_set);
+                if (was_set)
+                {
+                    reference.used[handle] = false;
+                }
+            }
+            for (size_t h = 0; h < max_routes; ++h)
+            {
+                EXPECT(tested.is_set(h) == reference.used[h]);
+                EXPECT(tested.is_locked(h) == (reference.used[h] and reference.set_routes[h].locked));
+                if (not reference.used[h])
+                {
+                    continue;
+                }
+                // Switches of set routes are not thrown by any other route. A route which turns
+                // at an end track may pass a switch twice, then its last setting stays.
+                const auto &settings = reference.set_routes[h].settings;
+                for (auto setting = settings.begin(); setting != settings.end(); ++setting)
+                {
+                    const auto [id, position] = *setting;
+                    const auto same = [id](const auto &other) { return other.first == id; };
+                    if (std::find_if(setting + 1, settings.end(), same) == settings.end())
+                    {
+                        EXPECT(state.switches[to_index(id)] == position);
+                    }
+                    EXPECT(tested.reservations().test(interlocking_type::position_bit(id, position)));
+                }
+            }
+            for (size_t i = 0; i < N; ++i)
+            {
+                const auto id = static_cast<trackid>(i);
+                EXPECT(tested.is_reserved(id) == reference.reserved(id, false));
+                EXPECT(tested.can_throw(id) == not reference.reserved(id, true));
+            }
+        }
+        std::printf("%zu operations, %zu routes set, %zu refused\n", operations, set, refused);
+    }
+
+    /// @brief Times setting routes and releasing them again, the same requests for both.
+    template <typename Set, typename Release>
+    double time_per_request(const std::vector<request> &requests, Set &&set, Release &&release)
+    {
+        std::vector<size_t> handles;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            const auto handle = set(requests[i]);
+            if (handle != interlocking_type::no_route)
+            {
+                handles.push_back(handle);
+            }
+            // Keep about half of the routes set, the requests then run into conflicts
+            if (handles.size() == max_routes or (i % 4 == 3 and not handles.empty()))
+            {
+                release(handles.front());
+                handles.erase(handles.begin());
+            }
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / double(requests.size());
+    }
+
+    void benchmark()
+    {
+        const auto requests = random_requests(200000);
+        track_state<N> state{};
+        interlocking_type tested(routes);
+        const auto bitset = time_per_request(requests, [&](const request r)
+                                             { return tested.set(r.source, r.destination, state); },
+                                             [&](const size_t handle)
+                                             { tested.release(handle); });
+        naive_interlocking reference;
+        const auto naive = time_per_request(requests, [&](const request r)
+                                            { return reference.set(r); },
+                                            [&](const size_t handle)
+                                            { reference.used[handle] = false; });
+        // The former compile-time matrix had a footprint and a row of conflicts for every route
+        const auto all_routes = 2 * routes.blocks() * routes.blocks();
+        std::printf("%zu tracks, %zu blocks, interlocking %zu bytes, conflict matrix would take %zu bytes\n", N,
+                    routes.blocks(), sizeof(interlocking_type),
+                    all_routes * (sizeof(typename interlocking_type::footprint) + (all_routes + 31) / 32 * 4));
+        std::printf("footprints %.1f ns per request, naive %.1f ns per request\n", bitset, naive);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    random_generator.seed(argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 1);
+    stress(20000);
+    if (failures)
+    {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    benchmark();
+    std::printf("The interlocking matches the naive reference\n");
+    return 0;
+}
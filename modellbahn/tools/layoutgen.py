@@ -0,0 +1,439 @@
+#!/usr/bin/env python3
+"""Generates the constexpr layout headers from a layout description.
+
+The description is a JSON file with three parts:
+
+    boards  Board types of the expansion, each with the number of input and
+            output bytes.
+    chains  The chains of the expansion, each a list of board types in the
+            order of the ioposition board index. The first chain is the
+            default one. A chain whose last board is wired back to MISO is
+            written as {"boards": [...], "loopback": true} instead, then
+            every transfer is checked with a loopback pattern. The check is
+            off for a plain list.
+    tracks  Every track of the layout. A track has an "id", a "type"
+            ("straight", "switch" or "end"), a "power" position, the
+            connected tracks "a" and "b" and, for switches, the "common"
+            track and the "straight" and "curved" positions. An "end" track
+            only has "a" and is closed on its other side. Any track may have
+            a "sense" input position of an occupancy sensor.
+
+A position is [board, bit] on the first chain or [chain, board, bit] with the
+name of the chain.
+
+The trackid enum is numbered in the order of the tracks. The generator checks
+that every link is symmetric, that no id dangles and that every I/O position
+exists in the chain as output or input and is used only once, and stops with one message per
+error. All checks are linear in the number of tracks.
+
+Besides the tracks and the chains it writes track/route_hops.hpp with the
+next-hop table of the shortest routes between all blocks, see next_hops().
+"""
+
+import argparse
+import heapq
+import json
+import re
+import sys
+from pathlib import Path
+
+IDENTIFIER = re.compile(r"^[A-Za-z_][A-Za-z0-9_]*$")
+MAX_TRACKS = 2**15 - 1
+HEADER = "// Generated by tools/layoutgen.py from {source}, do not edit.\n#pragma once"
+
+
+class LayoutError(Exception):
+    pass
+
+
+def position(track, key, chains, errors):
+    """Parses a position into (chain index, board, bit)."""
+    value = track.get(key)
+    if isinstance(value, list) and len(value) == 3 and value[0] in chains:
+        value = [list(chains).index(value[0])] + value[1:]
+    elif isinstance(value, list) and len(value) == 2:
+        value = [0] + value
+    if not (isinstance(value, list) and len(value) == 3 and all(isinstance(v, int) and v >= 0 for v in value)):
+        errors.append(f"{track.get('id')}: '{key}' must be [board, bit] or [chain, board, bit]")
+        return None
+    if value[0] >= len(chains):
+        errors.append(f"{track.get('id')}: '{key}' refers to chain {value[0]}, the layout has {len(chains)} chains")
+        return None
+    return tuple(value)
+
+
+def exists(pos, side, boards, chains):
+    chain, board, bit = pos
+    boards_of_chain = list(chains.values())[chain]
+    return board < len(boards_of_chain) and bit // 8 < boards[boards_of_chain[board]][side]
+
+
+def load(path):
+    with open(path, encoding="utf-8") as f:
+        description = json.load(f)
+
+    errors = []
+    boards = description.get("boards", {})
+    for name, board in boards.items():
+        if not IDENTIFIER.match(name):
+            errors.append(f"board type '{name}' is not an identifier")
+        for key in ("inputs", "outputs"):
+            if not isinstance(board.get(key), int) or board[key] < 0:
+                errors.append(f"board type '{name}': '{key}' must be a byte count")
+    chains = description.get("chains", {})
+    if not chains:
+        errors.append("no chain described")
+    if len(chains) > 255:
+        errors.append(f"{len(chains)} chains do not fit into ioposition")
+    loopback = set()
+    for chain, names in list(chains.items()):
+        if not IDENTIFIER.match(chain):
+            errors.append(f"chain '{chain}' is not an identifier")
+        if isinstance(names, dict):
+            if not isinstance(names.get("loopback", False), bool):
+                errors.append(f"chain '{chain}': 'loopback' must be true or false")
+            elif names.get("loopback", False):
+                loopback.add(chain)
+            names = chains[chain] = names.get("boards", [])
+        if not isinstance(names, list):
+            errors.append(f"chain '{chain}' must be a list of board types")
+            continue
+        for index, name in enumerate(names):
+            if name not in boards:
+                errors.append(f"{chain}[{index}]: unknown board type '{name}'")
+    if errors:
+        raise LayoutError(errors)
+
+    tracks = description.get("tracks", [])
+    if len(tracks) > MAX_TRACKS:
+        errors.append(f"{len(tracks)} tracks do not fit into trackid")
+    index = {}
+    for number, track in enumerate(tracks):
+        name = track.get("id")
+        if not isinstance(name, str) or not IDENTIFIER.match(name) or name == "INVALID":
+            errors.append(f"tracks[{number}]: invalid id {name!r}")
+        elif name in index:
+            errors.append(f"{name}: described more than once")
+        else:
+            index[name] = track
+
+    outputs = {}
+    inputs = {}
+    for track in tracks:
+        name = track.get("id")
+        kind = track.get("type")
+        if kind not in ("straight", "switch", "end"):
+            errors.append(f"{name}: unknown type {kind!r}")
+            continue
+        links = ["a"] if kind == "end" else ["a", "b", "common"] if kind == "switch" else ["a", "b"]
+        for key in links:
+            if not isinstance(track.get(key), str):
+                errors.append(f"{name}: '{key}' must be the id of a track, not {track.get(key)!r}")
+            elif track.get(key) not in index:
+                errors.append(f"{name}: '{key}' refers to unknown track {track.get(key)!r}")
+        if kind == "end" and "b" in track:
+            errors.append(f"{name}: an end track has no 'b'")
+        if kind != "switch" and any(key in track for key in ("common", "straight", "curved")):
+            errors.append(f"{name}: only switches have 'common', 'straight' and 'curved'")
+        keys = ["power", "straight", "curved"] if kind == "switch" else ["power"]
+        for key in keys:
+            pos = position(track, key, chains, errors)
+            if pos is None:
+                continue
+            if not exists(pos, "outputs", boards, chains):
+                errors.append(f"{name}: '{key}' {track[key]} is not an output of its chain")
+            elif pos in outputs:
+                errors.append(f"{name}: '{key}' {track[key]} is already used by {outputs[pos]}")
+            else:
+                outputs[pos] = f"{name}.{key}"
+        if "sense" in track:
+            pos = position(track, "sense", chains, errors)
+            if pos is None:
+                continue
+            if not exists(pos, "inputs", boards, chains):
+                errors.append(f"{name}: 'sense' {track['sense']} is not an input of its chain")
+            elif pos in inputs:
+                errors.append(f"{name}: 'sense' {track['sense']} is already used by {inputs[pos]}")
+            else:
+                inputs[pos] = name
+    if errors:
+        raise LayoutError(errors)
+
+    for track in tracks:
+        name = track["id"]
+        neighbours = neighbours_of(track)
+        if len(set(neighbours)) != len(neighbours):
+            errors.append(f"{name}: connected to the same track twice")
+        for other in neighbours:
+            if name not in neighbours_of(index[other]):
+                errors.append(f"{name}: linked to {other}, but {other} is not linked back")
+    if errors:
+        raise LayoutError(errors)
+    for track in tracks:
+        for key in ("power", "straight", "curved", "sense"):
+            if key in track:
+                track[key] = position(track, key, chains, errors)
+    return boards, chains, loopback, tracks
+
+
+def neighbours_of(track):
+    if track["type"] == "end":
+        return [track["a"]]
+    if track["type"] == "switch":
+        return [track["a"], track["b"], track["common"]]
+    return [track["a"], track["b"]]
+
+
+# switch_state and transition_table::connection
+STRAIGHT, CURVED, UNKNOWN = 0, 1, 2
+VIA_A, VIA_B, VIA_COMMON = 0, 1, 2
+HOPS_PER_BYTE = 4
+
+
+def connections(tracks):
+    """The indices of the tracks connected to each track as (a, b, common), None if unconnected."""
+    number = {t["id"]: i for i, t in enumerate(tracks)}
+    links = []
+    for t in tracks:
+        b = t["a"] if t["type"] == "end" else t["b"]
+        common = number[t["common"]] if t["type"] == "switch" else None
+        links.append((number[t["a"]], number[b], common))
+    return links
+
+
+def arrival_of(links, track, previous):
+    """The arrival at a track from a neighbour, same as transition_table::arrival_of()."""
+    for via in (VIA_COMMON, VIA_A, VIA_B):
+        if links[track][via] == previous:
+            return track * 3 + via
+    return None
+
+
+def ways_of(links, switches, arrival):
+    """The next arrivals and the switch_state each needs, same as transition::ways."""
+    track, via = divmod(arrival, 3)
+    a, b, common = links[track]
+    previous = links[track][via]
+    if previous is None:
+        return []
+    if track in switches:
+        if previous == common:
+            targets = [(a, STRAIGHT), (b, CURVED)]
+        else:
+            targets = [(common, STRAIGHT if previous == a else CURVED)]
+    else:
+        targets = [(b if previous == a else a, UNKNOWN)]
+    return [(arrival_of(links, target, track), state) for target, state in targets]
+
+
+def stride_of(blocks):
+    """The number of bytes of one row of the next-hop table."""
+    return (blocks + HOPS_PER_BYTE - 1) // HOPS_PER_BYTE
+
+
+def next_hops(tracks):
+    """Computes the next-hop table of the shortest routes between all blocks.
+
+    Every straight track is a block, numbered in trackid order like the switches. The table
+    has one row per switch with the switch_state a train entering it through its common track
+    takes toward each block, UNKNOWN if no block can be reached that way. The entries of a row
+    are 2 bits each, four per byte starting with the low bits. A train only has a choice at
+    such a switch, so following the rows from any block leads along a shortest route.
+
+    Between two switches a train has no choice either, so the graph is reduced to the
+    arrivals at switches and the segments between them first. Then a search from every
+    block backwards over the segments finds the distance from each switch. The work is
+    linear in the number of tracks plus blocks * switches * log(switches).
+    """
+    links = connections(tracks)
+    switches = {i for i, t in enumerate(tracks) if t["type"] == "switch"}
+    block_of = {}
+    for i in range(len(tracks)):
+        if i not in switches:
+            block_of[i] = len(block_of)
+    switch_row = {s: row for row, s in enumerate(sorted(switches))}
+
+    # For every way out of a switch arrival: the switch arrival it ends at, its length in
+    # tracks and the distance of every block on it, the first time the segment reaches it
+    segments = {}
+    entered = [[] for _ in block_of]
+    reverse = {}
+    for node in (s * 3 + via for s in sorted(switches) for via in (VIA_A, VIA_B, VIA_COMMON)):
+        segments[node] = []
+        for start, _ in ways_of(links, switches, node):
+            current, length, end, on_way = start, 1, None, {}
+            while True:
+                track = current // 3
+                if track in switches:
+                    end = current
+                    break
+                if block_of[track] not in on_way:
+                    on_way[block_of[track]] = length
+                    entered[block_of[track]].append((length, node))
+                following = ways_of(links, switches, current)
+                # A segment closing on itself without any switch never ends
+                if not following or length > 3 * len(tracks):
+                    break
+                current = following[0][0]
+                length += 1
+            segments[node].append((end, length, on_way))
+            if end is not None:
+                reverse.setdefault(end, []).append((node, length))
+
+    stride = stride_of(len(block_of))
+    # The ways a train entering a switch through its common track may take, with the offset of its row
+    facing = [(row * stride, tuple(zip(segments[s * 3 + VIA_COMMON], (STRAIGHT, CURVED))))
+              for s, row in switch_row.items()]
+    hops = bytearray([0xAA] * stride * len(switches))
+    for block, starts in enumerate(entered):
+        distance = {}
+        queue = list(starts)
+        heapq.heapify(queue)
+        while queue:
+            length, node = heapq.heappop(queue)
+            if node in distance:
+                continue
+            distance[node] = length
+            for previous, segment in reverse.get(node, ()):
+                if previous not in distance:
+                    heapq.heappush(queue, (length + segment, previous))
+
+        column = block // HOPS_PER_BYTE
+        shift = 2 * (block % HOPS_PER_BYTE)
+        mask = ~(3 << shift)
+        for offset, ways in facing:
+            best, state = None, UNKNOWN
+            for (end, length, on_way), way in ways:
+                cost = on_way.get(block)
+                if cost is None:
+                    cost = distance.get(end)
+                    if cost is None:
+                        continue
+                    cost += length
+                # The straight way wins a tie, as in transition::ways
+                if best is None or cost < best:
+                    best, state = cost, way
+            if state != UNKNOWN:
+                index = offset + column
+                hops[index] = (hops[index] & mask) | (state << shift)
+    return len(block_of), len(switches), bytes(hops)
+
+
+def ioposition(pos):
+    chain, board, bit = pos
+    return f"ioposition({board}, {bit})" if chain == 0 else f"ioposition({board}, {bit}, {chain})"
+
+
+def emit_trackid(tracks, source):
+    lines = [HEADER.format(source=source), "#include <cstdint>", "", "enum class trackid : int16_t", "{", "    INVALID = -1,"]
+    lines += [f"    {t['id']}," for t in tracks]
+    lines += ["};", ""]
+    return "\n".join(lines)
+
+
+def emit_description(tracks, source):
+    lines = [
+        HEADER.format(source=source),
+        "#include <array>",
+        '#include "track/description.hpp"',
+        "",
+        "/// @brief The tracks of the layout in trackid order.",
+        "static constexpr auto layout_description = std::to_array<track_description>({",
+    ]
+    for t in tracks:
+        tid = f"trackid::{t['id']}"
+        power = ioposition(t["power"])
+        if t["type"] == "switch":
+            entry = (
+                f"make_switch({tid}, {power}, trackid::{t['a']}, trackid::{t['b']}, trackid::{t['common']}, "
+                f"{ioposition(t['straight'])}, {ioposition(t['curved'])})"
+            )
+        elif t["type"] == "end":
+            # An end track is a straight track connected to the same track on both sides
+            entry = f"make_straight({tid}, {power}, trackid::{t['a']}, trackid::{t['a']})"
+        else:
+            entry = f"make_straight({tid}, {power}, trackid::{t['a']}, trackid::{t['b']})"
+        if "sense" in t:
+            entry = f"with_sensor({entry}, {ioposition(t['sense'])})"
+        lines.append(f"    {entry},")
+    lines += ["});", ""]
+    return "\n".join(lines)
+
+
+def emit_chain(boards, chains, loopback, source):
+    lines = [
+        HEADER.format(source=source),
+        "#include <cstddef>",
+        '#include "expansion/board_chain.hpp"',
+        "",
+    ]
+    for name, board in boards.items():
+        lines += [
+            f"struct {name}",
+            "{",
+            f"    static constexpr size_t inputs = {board['inputs']};",
+            f"    static constexpr size_t outputs = {board['outputs']};",
+            "};",
+        ]
+    for name, chain in chains.items():
+        boards_of_chain = f"board_chain<{', '.join(chain)}>"
+        lines.append(f"using {name}_chain = {f'looped_back<{boards_of_chain}>' if name in loopback else boards_of_chain};")
+    lines += [
+        "",
+        "/// @brief All chains of the expansion, ioposition::chain indexes them in this order.",
+        f"using expansion_chains = chain_set<{', '.join(f'{name}_chain' for name in chains)}>;",
+        "",
+    ]
+    return "\n".join(lines)
+
+
+def emit_routes(tracks, hops, source):
+    blocks, switches, table = hops
+    stride = stride_of(blocks)
+    lines = [
+        HEADER.format(source=source),
+        "#include <array>",
+        "#include <cstdint>",
+        "",
+        f"/// @brief Next hops of the shortest routes from the {switches} switches to the {blocks} blocks, see route_table.",
+        f"static constexpr std::array<uint8_t, {len(table)}> route_next_hops{{",
+    ]
+    names = [t["id"] for t in tracks if t["type"] == "switch"]
+    for row, name in enumerate(names):
+        entries = ", ".join(f"0x{value:02x}" for value in table[row * stride:(row + 1) * stride])
+        lines.append(f"    {entries}, // {name}")
+    lines += ["};", ""]
+    return "\n".join(lines)
+
+
+def write(path, content):
+    path.parent.mkdir(parents=True, exist_ok=True)
+    path.write_text(content, encoding="utf-8")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("layout", type=Path, help="the layout description")
+    parser.add_argument("output", type=Path, help="directory the headers are generated into")
+    args = parser.parse_args()
+
+    try:
+        boards, chains, loopback, tracks = load(args.layout)
+    except LayoutError as e:
+        for error in e.args[0]:
+            print(f"{args.layout}: {error}", file=sys.stderr)
+        return 1
+    except (OSError, json.JSONDecodeError) as e:
+        print(f"{args.layout}: {e}", file=sys.stderr)
+        return 1
+
+    source = args.layout.name
+    write(args.output / "track" / "trackid.hpp", emit_trackid(tracks, source))
+    write(args.output / "track" / "layout_description.hpp", emit_description(tracks, source))
+    write(args.output / "track" / "route_hops.hpp", emit_routes(tracks, next_hops(tracks), source))
+    write(args.output / "expansion" / "chain_config.hpp", emit_chain(boards, chains, loopback, source))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,170 @@
+// Host tool to write and verify layout images, see track/layout_image.hpp.
+//
+// The tables are taken from the compiled layout, so the tool is built against the headers
+// generated from the layout description:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target layoutimage
+//
+//   layoutimage write <image>    writes the image of the compiled layout
+//   layoutimage verify <image>   checks an image and compares it with the compiled layout
+//
+// The image is flashed to the layout image sector, see Board::LayoutImage.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <vector>
+#include "expansion/chain.hpp"
+#include "track/layout_routes.hpp"
+#include "track/layout_image.hpp"
+
+namespace
+{
+    constexpr size_t chains = expansion_chains::count;
+    constexpr size_t buffer_size = expansion_chains::total_buffer_size;
+
+    class image_writer
+    {
+    public:
+        image_writer() : bytes(sizeof(layout_image_header)) {}
+
+        template <typename T, size_t Size>
+        void add(const image_section section, const std::array<T, Size> &table)
+        {
+            while (bytes.size() % alignof(T))
+            {
+                bytes.push_back(0);
+            }
+            header.sections[static_cast<size_t>(section)] = {
+                .offset = static_cast<uint32_t>(bytes.size()),
+                .count = static_cast<uint32_t>(Size),
+            };
+            const auto *data = reinterpret_cast<const uint8_t *>(table.data());
+            bytes.insert(bytes.end(), data, data + sizeof(T) * Size);
+        }
+
+        std::vector<uint8_t> finish()
+        {
+            while (bytes.size() % alignof(layout_image_header))
+            {
+                bytes.push_back(0);
+            }
+            header.magic = layout_image_header::image_magic;
+            header.version = layout_image_header::image_version;
+            header.tracks = static_cast<uint16_t>(track_table.size());
+            header.blocks = static_cast<uint16_t>(route_rows.blocks);
+            header.chains = static_cast<uint16_t>(chains);
+            header.size = static_cast<uint32_t>(bytes.size());
+            header.buffer_size = static_cast<uint32_t>(buffer_size);
+            std::memcpy(bytes.data(), &header, sizeof(header));
+            header.crc = layout_image::crc_of(bytes.data(), bytes.size());
+            std::memcpy(bytes.data(), &header, sizeof(header));
+            return bytes;
+        }
+
+    private:
+        layout_image_header header{};
+        std::vector<uint8_t> bytes;
+    };
+
+    std::vector<uint8_t> build_image()
+    {
+        image_writer writer;
+        writer.add(image_section::type, track_table.type);
+        writer.add(image_section::track_a, track_table.track_a);
+        writer.add(image_section::track_b, track_table.track_b);
+        writer.add(image_section::track_common, track_table.track_common);
+        writer.add(image_section::power_bit, track_table.power_bit);
+        writer.add(image_section::straight_bit, track_table.straight_bit);
+        writer.add(image_section::curved_bit, track_table.curved_bit);
+        writer.add(image_section::sense_bit, track_table.sense_bit);
+        writer.add(image_section::transitions, transitions.rows);
+        writer.add(image_section::block_index, route_rows.block_index);
+        writer.add(image_section::switch_index, route_rows.switch_index);
+        writer.add(image_section::next_hops, route_next_hops);
+        return writer.finish();
+    }
+
+    const char *to_string(const layout_image::status status)
+    {
+        switch (status)
+        {
+        case layout_image::status::OK:
+            return "ok";
+        case layout_image::status::MISSING:
+            return "not a layout image";
+        case layout_image::status::BAD_VERSION:
+            return "unsupported version";
+        case layout_image::status::BAD_SIZE:
+            return "size mismatch";
+        case layout_image::status::BAD_CRC:
+            return "CRC mismatch";
+        case layout_image::status::BAD_TABLE:
+            return "table misplaced or of wrong size";
+        case layout_image::status::BAD_REFERENCE:
+            return "table refers to missing entries";
+        case layout_image::status::BAD_CHAIN:
+            return "built for another expansion chain";
+        }
+        return "unknown";
+    }
+
+    template <typename T, size_t Size>
+    bool same(const std::span<const T> image, const std::array<T, Size> &compiled)
+    {
+        return image.size() == Size and std::memcmp(image.data(), compiled.data(), sizeof(T) * Size) == 0;
+    }
+
+    int write(const char *path)
+    {
+        const auto image = build_image();
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+        if (not file)
+        {
+            std::fprintf(stderr, "%s: cannot write\n", path);
+            return 1;
+        }
+        std::printf("%s: %zu tracks, %zu blocks, %zu bytes\n", path, track_table.size(), route_rows.blocks, image.size());
+        return 0;
+    }
+
+    int verify(const char *path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        const std::vector<uint8_t> bytes(std::istreambuf_iterator<char>(file), {});
+        const auto status = layout_image::check(bytes.data(), bytes.size(), expansion_chains::buffer_sizes);
+        if (status != layout_image::status::OK)
+        {
+            std::fprintf(stderr, "%s: %s\n", path, to_string(status));
+            return 1;
+        }
+        const auto image = layout_image::open(bytes.data());
+        const bool matches = image.tracks() == track_table.size() and image.blocks() == route_rows.blocks and
+                             same(image.type(), track_table.type) and same(image.track_a(), track_table.track_a) and
+                             same(image.track_b(), track_table.track_b) and same(image.track_common(), track_table.track_common) and
+                             same(image.power_bit(), track_table.power_bit) and same(image.straight_bit(), track_table.straight_bit) and
+                             same(image.curved_bit(), track_table.curved_bit) and same(image.sense_bit(), track_table.sense_bit) and
+                             same(image.transitions(), transitions.rows) and
+                             same(image.block_index(), route_rows.block_index) and same(image.switch_index(), route_rows.switch_index) and
+                             same(image.next_hops(), route_next_hops);
+        std::printf("%s: valid, %zu tracks, %s the compiled layout\n", path, image.tracks(), matches ? "matches" : "differs from");
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 and std::strcmp(argv[1], "write") == 0)
+    {
+        return write(argv[2]);
+    }
+    if (argc == 3 and std::strcmp(argv[1], "verify") == 0)
+    {
+        return verify(argv[2]);
+    }
+    std::fprintf(stderr, "usage: %s write|verify <image>\n", argv[0]);
+    return 2;
+}
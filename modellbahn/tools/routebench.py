@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Measures the size and build time of the route tables for large synthetic layouts.
+
+Every synthetic layout is a ring of stations. A station has a switch on each
+side and two parallel tracks in between, the stations are joined by plain
+tracks and every fourth station has a siding with an end track. The tool
+generates the headers of each layout with tools/layoutgen.py and reports the
+number of tracks, blocks and switches, the size of the next-hop table and the
+time layoutgen.py takes to compute it. For comparison it also reports the size
+the former all-pairs route table would have had, a 12 byte entry for each of
+the blocks * 2 * blocks routes without the pools of their tracks and switch
+settings.
+
+With --cxx the tool also builds tools/routecheck.cpp,
+tools/interlockbench.cpp and tools/trainbench.cpp against the headers of each
+layout, reports their compile time and runs them. The first compares every
+route with a breadth first search, the second sets and releases random routes
+and the third reports the trains advanced per millisecond:
+
+    routebench.py 100 1000 3000
+    routebench.py --cxx g++ 100 1000
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+TOOLS = Path(__file__).resolve().parent
+sys.path.insert(0, str(TOOLS))
+import layoutgen  # noqa: E402
+
+# The host checks built for every layout with --cxx
+CHECKS = ("routecheck", "interlockbench", "trainbench")
+
+# Output bytes of one board of the synthetic chain
+BOARD_OUTPUTS = 32
+
+
+def synthetic(size):
+    """A layout description with about size tracks."""
+    tracks = []
+    outputs = iter(range(1 << 30))
+
+    def output():
+        bit = next(outputs)
+        return [bit // (BOARD_OUTPUTS * 8), bit % (BOARD_OUTPUTS * 8)]
+
+    def add(track):
+        track["power"] = output()
+        if track["type"] == "switch":
+            track["straight"] = output()
+            track["curved"] = output()
+        tracks.append(track)
+
+    # A station takes 6 tracks in the ring, 8 with a siding, and 2 joining tracks follow it
+    stations = max(1, size // 9)
+    for n in range(stations):
+        after = f"S{(n + 1) % stations}_in"
+        siding = n % 4 == 3
+        add({"id": f"S{n}_in", "type": "switch", "a": f"S{n}_1a", "b": f"S{n}_2a", "common": f"J{(n - 1) % stations}_b"})
+        add({"id": f"S{n}_1a", "type": "straight", "a": f"S{n}_in", "b": f"S{n}_1b"})
+        add({"id": f"S{n}_1b", "type": "straight", "a": f"S{n}_1a", "b": f"S{n}_out"})
+        add({"id": f"S{n}_2a", "type": "straight", "a": f"S{n}_in", "b": f"S{n}_2b"})
+        add({"id": f"S{n}_2b", "type": "straight", "a": f"S{n}_2a", "b": f"S{n}_out" if not siding else f"S{n}_x"})
+        if siding:
+            add({"id": f"S{n}_x", "type": "switch", "a": f"S{n}_2b", "b": f"S{n}_end", "common": f"S{n}_out"})
+            add({"id": f"S{n}_end", "type": "end", "a": f"S{n}_x"})
+        add({"id": f"S{n}_out", "type": "switch", "a": f"S{n}_1b", "b": f"S{n}_2b" if not siding else f"S{n}_x",
+             "common": f"J{n}_a"})
+        add({"id": f"J{n}_a", "type": "straight", "a": f"S{n}_out", "b": f"J{n}_b"})
+        add({"id": f"J{n}_b", "type": "straight", "a": f"J{n}_a", "b": after})
+
+    boards = (next(outputs) + BOARD_OUTPUTS * 8 - 1) // (BOARD_OUTPUTS * 8)
+    return {
+        "boards": {"synthetic": {"inputs": 0, "outputs": BOARD_OUTPUTS}},
+        "chains": {"main": ["synthetic"] * boards},
+        "tracks": tracks,
+    }
+
+
+def measure(size, directory):
+    description = directory / "layout.json"
+    description.write_text(json.dumps(synthetic(size)), encoding="utf-8")
+    boards, chains, loopback, tracks = layoutgen.load(description)
+    start = time.perf_counter()
+    blocks, switches, hops = layoutgen.next_hops(tracks)
+    elapsed = time.perf_counter() - start
+    generated = directory / "generated"
+    subprocess.run([sys.executable, str(TOOLS / "layoutgen.py"), str(description), str(generated)], check=True)
+    return len(tracks), blocks, switches, len(hops), 12 * blocks * 2 * blocks, elapsed, generated
+
+
+def build_check(cxx, check, generated, directory):
+    binary = directory / check
+    command = [cxx, "-std=c++23", "-O2", "-fconstexpr-ops-limit=1000000000", "-fconstexpr-loop-limit=1000000",
+               "-I", str(TOOLS.parent), "-I", str(generated), str(TOOLS / f"{check}.cpp"), "-o", str(binary)]
+    start = time.perf_counter()
+    result = subprocess.run(command, capture_output=True, text=True)
+    elapsed = time.perf_counter() - start
+    if result.returncode != 0:
+        return elapsed, False, result.stderr.strip().splitlines()[:5]
+    result = subprocess.run([str(binary)], capture_output=True, text=True)
+    return elapsed, result.returncode == 0, result.stdout.strip().splitlines()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("sizes", type=int, nargs="*", default=[100, 1000, 3000], help="approximate numbers of tracks")
+    parser.add_argument("--cxx", help="compiler to build and run the checks with for each layout")
+    args = parser.parse_args()
+
+    print(f"{'tracks':>7} {'blocks':>7} {'switches':>8} {'next hops':>12} {'all pairs':>12} {'layoutgen':>10}")
+    failed = False
+    for size in args.sizes:
+        with tempfile.TemporaryDirectory() as temporary:
+            directory = Path(temporary)
+            tracks, blocks, switches, hops, pairs, elapsed, generated = measure(size, directory)
+            print(f"{tracks:>7} {blocks:>7} {switches:>8} {hops:>10} B {pairs:>10} B {elapsed:>8.3f} s")
+            for check in CHECKS if args.cxx else ():
+                compile_time, passed, output = build_check(args.cxx, check, generated, directory)
+                print(f"        {check}, compiled in {compile_time:.1f} s")
+                for text in output:
+                    print(f"        {text}")
+                failed |= not passed
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
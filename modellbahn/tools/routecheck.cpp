@@ -0,0 +1,194 @@
+// Host check of the routes between the blocks, see track/route.hpp.
+//
+// Runs a breadth first search over the arrivals from every block in both directions and checks
+// that the next-hop table of tools/layoutgen.py finds a route to exactly the blocks the search
+// reaches, that each route is as short as the shortest one and that it is a walk through the
+// layout with the switch settings make_way_to() would choose. Then it times the route lookups.
+// It is built against the generated headers, tools/routebench.py builds it for large synthetic
+// layouts:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target routecheck
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "track/layout_routes.hpp"
+
+namespace
+{
+    constexpr size_t N = track_table.size();
+    using table_type = transition_table<N>;
+
+    int failures = 0;
+
+    template <typename... Args>
+    void fail(const char *format, Args... args)
+    {
+        // The first few failures tell enough, a broken table fails thousands of routes
+        if (++failures <= 10)
+        {
+            std::printf(format, args...);
+        }
+    }
+
+    /// @brief Distances of a breadth first search over the arrivals from one arrival.
+    std::vector<size_t> search(const arrival source)
+    {
+        std::vector<size_t> distance(N * 3, SIZE_MAX);
+        std::vector<arrival> queue{source};
+        distance[source] = 0;
+        for (size_t head = 0; head < queue.size(); ++head)
+        {
+            const auto current = queue[head];
+            const auto &step = transitions[current];
+            for (size_t w = 0; w < step.ways.size(); ++w)
+            {
+                if (step.ways[w] == trackid::INVALID)
+                {
+                    continue;
+                }
+                const auto state = step.way_state[w];
+                const auto next = step.next_arrival[static_cast<size_t>(state == switch_state::UNKNOWN ? switch_state::STRAIGHT : state)];
+                if (next != invalid_arrival and distance[next] == SIZE_MAX)
+                {
+                    distance[next] = distance[current] + 1;
+                    queue.push_back(next);
+                }
+            }
+        }
+        return distance;
+    }
+
+    /// @brief Checks the route from one arrival at a block to another block.
+    void check_route(const arrival source, const trackid destination, const std::vector<size_t> &distance)
+    {
+        size_t shortest = SIZE_MAX;
+        for (size_t via = 0; via < 3; ++via)
+        {
+            shortest = std::min(shortest, distance[to_index(destination) * 3 + via]);
+        }
+        const auto from = table_type::track_of(source);
+        std::vector<std::pair<trackid, switch_state>> walk;
+        const auto length = routes.route(source, destination, [&walk](const trackid id, const switch_state state)
+                                         { walk.emplace_back(id, state); });
+        if ((shortest == SIZE_MAX) != (length == 0) or (length != 0 and length != shortest))
+        {
+            fail("FAIL route from %d (arrival %u) to %d: %zu tracks, shortest %zu\n", static_cast<int>(from), source,
+                 static_cast<int>(destination), length, shortest == SIZE_MAX ? 0 : shortest);
+            return;
+        }
+        if (length == 0)
+        {
+            return;
+        }
+        // Every track follows its predecessor and the settings are those of make_way_to()
+        auto previous = table_type::previous_of(track_table, source);
+        auto current = from;
+        for (size_t i = 0; i < walk.size(); ++i)
+        {
+            const auto [id, state] = walk[i];
+            const auto ways = track_table.next_tracks(current, previous);
+            if (id != ways[0] and id != ways[1])
+            {
+                fail("FAIL route from %d to %d leaves %d to %d\n", static_cast<int>(from), static_cast<int>(destination),
+                     static_cast<int>(current), static_cast<int>(id));
+                return;
+            }
+            if (i + 1 < walk.size())
+            {
+                auto expected = switch_state::UNKNOWN;
+                track_table.make_way_to(id, walk[i + 1].first, current, expected);
+                if (state != expected)
+                {
+                    fail("FAIL route from %d to %d sets %d to %d\n", static_cast<int>(from), static_cast<int>(destination),
+                         static_cast<int>(id), static_cast<int>(state));
+                }
+            }
+            previous = current;
+            current = id;
+        }
+        if (current != destination)
+        {
+            fail("FAIL route from %d ends at %d instead of %d\n", static_cast<int>(from), static_cast<int>(current), static_cast<int>(destination));
+        }
+    }
+
+    /// @brief The arrivals at the blocks, two per block.
+    std::vector<arrival> sources()
+    {
+        std::vector<arrival> result;
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (routes.is_block(static_cast<trackid>(i)))
+            {
+                result.push_back(static_cast<arrival>(i * 3 + table_type::via_a));
+                result.push_back(static_cast<arrival>(i * 3 + table_type::via_b));
+            }
+        }
+        return result;
+    }
+
+    std::vector<trackid> blocks()
+    {
+        std::vector<trackid> result;
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (routes.is_block(static_cast<trackid>(i)))
+            {
+                result.push_back(static_cast<trackid>(i));
+            }
+        }
+        return result;
+    }
+
+    /// @brief Prints the time of a route lookup and of setting its switches.
+    void benchmark()
+    {
+        const auto from = sources();
+        const auto to = blocks();
+        track_state<N> state{};
+        size_t found = 0;
+        size_t tracks = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto source : from)
+        {
+            for (const auto destination : to)
+            {
+                const auto length = routes.length(source, destination);
+                found += length != 0;
+                tracks += length;
+                routes.set_switches(source, destination, state);
+            }
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        const auto requests = from.size() * to.size();
+        std::printf("%zu tracks, %zu blocks, %zu switches, next hops %zu bytes\n", N, route_rows.blocks, route_rows.switches,
+                    route_next_hops.size());
+        std::printf("%zu of %zu routes, average %.1f tracks, %.1f ns per route and its switches\n", found, requests,
+                    found ? double(tracks) / double(found) : 0.0, elapsed.count() / double(requests ? requests : 1));
+    }
+}
+
+int main()
+{
+    for (const auto source : sources())
+    {
+        const auto distance = search(source);
+        for (const auto destination : blocks())
+        {
+            if (destination != table_type::track_of(source))
+            {
+                check_route(source, destination, distance);
+            }
+        }
+    }
+    if (failures)
+    {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    benchmark();
+    std::printf("Routes match the shortest routes of the layout\n");
+    return 0;
+}
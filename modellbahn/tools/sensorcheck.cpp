@@ -0,0 +1,322 @@
+// Host check of the inputs of the expansion chains and the occupancy sensors, see
+// expansion/chain_io.hpp and flat_layout::detect_occupancy().
+//
+// Every chain gets simulated shift registers which load the input pins of the boards when the
+// latch falls and shift them out while the frame is shifted in. The byte of a pin is taken from
+// the board sizes of the description, not from resolve_input(). The check sets the pins one at
+// a time and checks that the input arrives with the same refresh at get_input(), and only there.
+// Then it sets the sensors of random tracks and checks the occupancy read from the received and
+// from the debounced inputs, through the flat tables, the layout_view and the compile-time
+// get_input<ioposition>(), and that a train stops in front of a detected track. The layout
+// description needs input boards and sensors, tools/CMakeLists.txt builds the check against
+// tools/sensor_layout.json, whose second chain is looped_back:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target sensorcheck
+
+#include <array>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+#include "expansion/chain_group.hpp"
+#include "track/layout.hpp"
+#include "track/layout_view.hpp"
+#include "track/train_engine.hpp"
+
+namespace
+{
+    constexpr size_t chains = expansion_chains::count;
+    constexpr size_t N = track_table.size();
+
+    std::mt19937 random_generator(1);
+    int failures = 0;
+
+    void expect(const bool condition, const char *what, const int line)
+    {
+        // The first few failures tell enough, a wrong offset fails for every input
+        if (not condition and ++failures <= 10)
+        {
+            std::printf("FAIL line %d: %s\n", line, what);
+        }
+    }
+#define EXPECT(condition) expect(condition, #condition, __LINE__)
+
+    /// @brief The boards of a chain, their pins and their shift registers.
+    struct simulated_chain
+    {
+        /// @brief The input pins in the order the registers shift them out.
+        std::vector<uint8_t> pins;
+        std::vector<uint8_t> shift;
+        const uint8_t *tx = nullptr;
+        uint8_t *rx = nullptr;
+        size_t length = 0;
+    };
+
+    std::array<simulated_chain, chains> simulated;
+
+    struct simulated_latch
+    {
+        /// @brief The boards load their pins into the shift registers.
+        static void reset()
+        {
+            for (auto &chain : simulated)
+            {
+                chain.shift = chain.pins;
+            }
+        }
+
+        static void set() {}
+    };
+
+    template <size_t I>
+    struct simulated_transport
+    {
+        static void start(const uint8_t *tx, uint8_t *rx, const size_t length)
+        {
+            simulated[I].tx = tx;
+            simulated[I].rx = rx;
+            simulated[I].length = length;
+        }
+
+        /// @brief Shifts the frame in and the registers out, the registers keep the end of the frame.
+        static bool wait()
+        {
+            auto &chain = simulated[I];
+            std::vector<uint8_t> stream = chain.shift;
+            stream.insert(stream.end(), chain.tx, chain.tx + chain.length);
+            std::copy(stream.begin(), stream.begin() + static_cast<ptrdiff_t>(chain.length), chain.rx);
+            chain.shift.assign(stream.end() - static_cast<ptrdiff_t>(chain.shift.size()), stream.end());
+            return true;
+        }
+    };
+
+    template <size_t... I>
+    chain_group<simulated_latch, simulated_transport<I>...> make_group(std::index_sequence<I...>);
+
+    using group_type = decltype(make_group(std::make_index_sequence<chains>{}));
+
+    group_type group;
+
+    /// @brief An input pin of a board.
+    struct pin
+    {
+        ioposition pos;
+
+        /// @brief The byte of the pin in the registers, the last board shifts out first.
+        size_t byte;
+    };
+
+    std::vector<pin> pins;
+
+    template <size_t I>
+    void collect_pins()
+    {
+        using chain_type = typename expansion_chains::template chain<I>;
+        size_t offset = 0;
+        for (size_t board = chain_type::board_count; board-- > 0;)
+        {
+            for (size_t bit = 0; bit < chain_type::boards[board].inputs * 8; ++bit)
+            {
+                pins.push_back({{board, static_cast<uint8_t>(bit), static_cast<uint8_t>(I)}, offset + bit / 8});
+            }
+            offset += std::max(chain_type::boards[board].inputs, chain_type::boards[board].outputs);
+        }
+        simulated[I].pins.assign(chain_type::buffer_size, 0);
+        simulated[I].shift = simulated[I].pins;
+    }
+
+    void set_pin(const pin &p, const bool state)
+    {
+        auto &byte = simulated[p.pos.chain].pins[p.byte];
+        const auto mask = static_cast<uint8_t>(1 << (p.pos.bit_pos % 8));
+        byte = static_cast<uint8_t>(state ? byte | mask : byte & ~mask);
+    }
+
+    /// @brief Clears all pins, the bits without a pin are set so they show up if read as inputs.
+    void clear_pins()
+    {
+        for (auto &chain : simulated)
+        {
+            std::fill(chain.pins.begin(), chain.pins.end(), 0xff);
+        }
+        for (const auto &p : pins)
+        {
+            set_pin(p, false);
+        }
+    }
+
+    template <size_t I>
+    uint32_t frames_of() { return group.chain<I>().input_frames(); }
+
+    uint32_t input_frames()
+    {
+        return [&]<size_t... I>(std::index_sequence<I...>)
+        { return (frames_of<I>() + ...); }(std::make_index_sequence<chains>{});
+    }
+
+    /// @brief Sets every pin on its own and checks that only its input follows, with the same refresh.
+    void check_pins()
+    {
+        for (const auto &p : pins)
+        {
+            EXPECT(is_valid_input(p.pos));
+            clear_pins();
+            set_pin(p, true);
+            const auto frames = input_frames();
+            group.refresh();
+            EXPECT(input_frames() == frames + chains);
+            for (const auto &other : pins)
+            {
+                EXPECT(group.get_input(resolve_input(other.pos)) == (&other == &p));
+            }
+        }
+        clear_pins();
+        group.refresh();
+    }
+
+    /// @brief The occupancy of the sensed tracks as the engine reads it from some buffers of all chains.
+    template <typename Buffer>
+    word_bitset<N> occupancy(Buffer &&buffer)
+    {
+        word_bitset<N> detected{};
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { ((detected |= track_table.detect_occupancy(buffer(group.chain<I>()), I)), ...); }(std::make_index_sequence<chains>{});
+        return detected;
+    }
+
+    /// @brief The same through the layout_view, as for a layout image.
+    word_bitset<N> occupancy_of_view()
+    {
+        const layout_view view(track_table, transitions);
+        word_bitset<N> detected{};
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { ((detected |= view.detect_occupancy<N>(group.chain<I>().in_buffer.data(), I)), ...); }(std::make_index_sequence<chains>{});
+        return detected;
+    }
+
+    /// @brief The sensors read one by one with the inputs resolved at compile time.
+    word_bitset<N> occupancy_of_typed_inputs()
+    {
+        word_bitset<N> detected{};
+        [&]<size_t... K>(std::index_sequence<K...>)
+        {
+            (
+                [&]
+                {
+                    if constexpr (layout_description[K].sensed)
+                    {
+                        detected.set(to_index(layout_description[K].id), group.get_input<layout_description[K].sense_pos>());
+                    }
+                }(),
+                ...);
+        }(std::make_index_sequence<N>{});
+        return detected;
+    }
+
+    /// @brief Sets the sensors of random tracks and checks the occupancy read back.
+    void check_occupancy(const size_t rounds)
+    {
+        const auto samples = group.chain<0>().debounced_inputs.samples();
+        word_bitset<N> previous{};
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            clear_pins();
+            word_bitset<N> occupied{};
+            track_table.sensed.for_each([&](const size_t i)
+                                        {
+                                            if (random_generator() % 3 == 0)
+                                            {
+                                                occupied.set(i);
+                                            }
+                                        });
+            for (const auto &p : pins)
+            {
+                // The sensor pins follow the occupancy, the free pins are random
+                bool state = random_generator() % 2;
+                for (size_t i = 0; i < N; ++i)
+                {
+                    const auto &pos = track_table.sense_pos[i];
+                    if (track_table.sensed.test(i) and pos.chain == p.pos.chain and pos.board == p.pos.board and pos.bit_pos == p.pos.bit_pos)
+                    {
+                        state = occupied.test(i);
+                    }
+                }
+                set_pin(p, state);
+            }
+            const auto received = [](const auto &io)
+            { return io.in_buffer.data(); };
+            const auto debounced = [](const auto &io)
+            { return io.debounced_inputs.data(); };
+            for (size_t n = 1; n <= samples; ++n)
+            {
+                group.refresh();
+                EXPECT(occupancy(received) == occupied);
+                EXPECT(occupancy_of_view() == occupied);
+                EXPECT(occupancy_of_typed_inputs() == occupied);
+                // The debounced inputs take over after the configured number of samples
+                EXPECT(occupancy(debounced) == (n < samples ? previous : occupied));
+            }
+            previous = occupied;
+        }
+    }
+
+    /// @brief Runs a train towards every sensed track and checks that it stops in front of it.
+    void check_trains()
+    {
+        size_t stopped = 0;
+        for (size_t t = 0; t < N; ++t)
+        {
+            if (track_table.type[t] != track_type::Straight or track_table.track_a[t] == track_table.track_b[t])
+            {
+                continue;
+            }
+            for (const auto &[ahead, behind] : {std::pair{track_table.track_a[t], track_table.track_b[t]}, std::pair{track_table.track_b[t], track_table.track_a[t]}})
+            {
+                if (not track_table.sensed.test(to_index(ahead)))
+                {
+                    continue;
+                }
+                track_state<N> state{};
+                train_engine<N, 1> engine(track_table, transitions, state);
+                const auto train = engine.add(static_cast<trackid>(t), behind, train_engine<N, 1>::track_length);
+                EXPECT(train == 0);
+                word_bitset<N> detected{};
+                detected.set(to_index(ahead));
+                engine.set_detected(detected);
+                engine.tick();
+                EXPECT(engine[0].status == train_status::COLLISION and engine.current_of(0) == static_cast<trackid>(t));
+                // It waits at the end of its track, so it enters the next one with any speed
+                engine.set_detected({});
+                engine.set_speed(0, 1);
+                engine.tick();
+                EXPECT(engine[0].status == train_status::RUNNING and engine.current_of(0) == ahead);
+                ++stopped;
+            }
+        }
+        EXPECT(stopped > 0);
+        std::printf("%zu trains stopped in front of a detected track\n", stopped);
+    }
+}
+
+int main()
+{
+    [&]<size_t... I>(std::index_sequence<I...>)
+    { (collect_pins<I>(), ...); }(std::make_index_sequence<chains>{});
+    if (pins.empty() or track_table.sensed.none())
+    {
+        std::printf("The layout has no inputs or no sensors, use tools/sensor_layout.json\n");
+        return 1;
+    }
+    check_pins();
+    check_occupancy(200);
+    check_trains();
+    // The looped back chains return their pattern behind the inputs
+    EXPECT(group.take_faults() == 0);
+    if (failures)
+    {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    std::printf("%zu chains, %zu inputs, every input and sensor arrives with its refresh\n", chains, pins.size());
+    return 0;
+}
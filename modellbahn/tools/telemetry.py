@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""Decodes the binary telemetry of the stlink UART into CSV or JSON lines.
+
+The firmware sends frames of telemetry/frame.hpp at 921600 baud:
+
+    sync      0x5aa5, the bytes a5 5a
+    type      1 measurement, 2 tracks, 3 controller
+    version   1
+    length    of the payload
+    sequence  counts all frames, also those dropped on the target
+    time      of the content in us
+    payload   length bytes
+    crc       CRC16-CCITT, init 0xffff, from type to the end of the payload
+
+Everything is little endian. The decoder searches the sync bytes, so it can
+start in the middle of a stream and skips every frame with a wrong CRC. Gaps
+of the sequence are frames lost on the target or on the way. The tracks are
+decoded into the indices of the tracks in each bitset.
+
+Read a capture with
+
+    telemetry.py capture.bin --format json
+    stty -F /dev/ttyACM0 921600 raw && telemetry.py /dev/ttyACM0 --type tracks
+
+CSV holds one type of frame, JSON lines hold all unless --type is given. A
+summary of the stream goes to stderr at the end.
+"""
+
+import argparse
+import csv
+import json
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+VERSION = 1
+HEADER = struct.Struct("<2sBBHHI")
+CRC = struct.Struct("<H")
+MAX_PAYLOAD = 256
+
+MEASUREMENT = struct.Struct("<HHHHHBBI")
+TRACKS = struct.Struct("<HBB")
+CONTROLLER = struct.Struct("<IIIIIHHHHI")
+TRIP_STATES = ("armed", "tripped", "locked_out")
+BITSETS = ("powered", "curved", "sensed", "occupied")
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    """The CRC of modm::math::crc16_ccitt()."""
+    for byte in data:
+        byte ^= crc & 0xFF
+        byte = (byte ^ (byte << 4)) & 0xFF
+        crc = ((byte << 8) | (crc >> 8)) ^ (byte >> 4) ^ (byte << 3)
+    return crc & 0xFFFF
+
+
+def measurement(payload):
+    current, voltage, temperature, peak, trips, state, _, dropped = MEASUREMENT.unpack_from(payload)
+    return {
+        "current": current,
+        "voltage": voltage,
+        "temperature": temperature,
+        "peak": peak,
+        "trips": trips,
+        "trip_state": TRIP_STATES[state] if state < len(TRIP_STATES) else state,
+        "dropped": dropped,
+    }
+
+
+def tracks(payload):
+    count, trains, safe_state = TRACKS.unpack_from(payload)
+    words = (count + 31) // 32
+    values = struct.unpack_from(f"<{len(BITSETS) * words}I", payload, TRACKS.size)
+    record = {"tracks": count, "trains": trains, "safe_state": bool(safe_state)}
+    for n, name in enumerate(BITSETS):
+        bits = values[n * words:(n + 1) * words]
+        record[name] = [i for i in range(count) if bits[i // 32] >> (i % 32) & 1]
+    return record
+
+
+def controller(payload):
+    names = ("issued", "skipped", "coalesced", "periods", "missed", "min_period", "max_period",
+             "average_period", "faulty", "integrity_errors")
+    return dict(zip(names, CONTROLLER.unpack_from(payload)))
+
+
+# Type, name, decoder and the smallest payload
+RECORDS = {
+    1: ("measurement", measurement, MEASUREMENT.size),
+    2: ("tracks", tracks, TRACKS.size),
+    3: ("controller", controller, CONTROLLER.size),
+}
+
+
+class Decoder:
+    """Finds the frames in a stream of bytes, fed in chunks of any size."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.frames = 0
+        self.crc_errors = 0
+        self.skipped = 0
+        self.lost = 0
+        self.sequence = None
+
+    def feed(self, data):
+        """Yields (type, sequence, time, payload) of every complete frame."""
+        self.buffer += data
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # Keeps a last a5, it may start the next sync
+                keep = 1 if self.buffer.endswith(SYNC[:1]) else 0
+                self.skipped += len(self.buffer) - keep
+                del self.buffer[:len(self.buffer) - keep]
+                return
+            self.skipped += start
+            del self.buffer[:start]
+            if len(self.buffer) < HEADER.size:
+                return
+            _, kind, version, length, sequence, time = HEADER.unpack_from(self.buffer)
+            if version != VERSION or length > MAX_PAYLOAD:
+                self.resync()
+                continue
+            end = HEADER.size + length
+            if len(self.buffer) < end + CRC.size:
+                return
+            (crc,) = CRC.unpack_from(self.buffer, end)
+            if crc != crc16_ccitt(self.buffer[len(SYNC):end]):
+                self.crc_errors += 1
+                self.resync()
+                continue
+            payload = bytes(self.buffer[HEADER.size:end])
+            del self.buffer[:end + CRC.size]
+            self.frames += 1
+            if self.sequence is not None:
+                self.lost += (sequence - self.sequence - 1) & 0xFFFF
+            self.sequence = sequence
+            yield kind, sequence, time, payload
+
+    def resync(self):
+        """Drops the sync of a broken frame, the next one may start within it."""
+        self.skipped += len(SYNC)
+        del self.buffer[:len(SYNC)]
+
+
+def read_chunks(stream):
+    read = getattr(stream, "read1", stream.read)
+    while chunk := read(4096):
+        yield chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", default="-", help="capture or serial device, - for stdin")
+    parser.add_argument("--format", choices=("csv", "json"), default="csv")
+    parser.add_argument("--type", choices=[name for name, _, _ in RECORDS.values()],
+                        help="the frames to print, csv defaults to measurement")
+    args = parser.parse_args()
+    selected = args.type or ("measurement" if args.format == "csv" else None)
+
+    decoder = Decoder()
+    writer = None
+    unknown = 0
+    try:
+        stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+    except OSError as e:
+        print(f"{args.input}: {e}", file=sys.stderr)
+        return 1
+    with stream:
+        try:
+            for chunk in read_chunks(stream):
+                for kind, sequence, time, payload in decoder.feed(chunk):
+                    if kind not in RECORDS or len(payload) < RECORDS[kind][2]:
+                        unknown += 1
+                        continue
+                    name, decode, _ = RECORDS[kind]
+                    if selected and name != selected:
+                        continue
+                    try:
+                        record = {"sequence": sequence, "time": time, **decode(payload)}
+                    except struct.error:
+                        unknown += 1
+                        continue
+                    if args.format == "json":
+                        print(json.dumps({"type": name, **record}), flush=True)
+                        continue
+                    if writer is None:
+                        writer = csv.DictWriter(sys.stdout, fieldnames=list(record))
+                        writer.writeheader()
+                    writer.writerow({k: " ".join(map(str, v)) if isinstance(v, list) else v
+                                     for k, v in record.items()})
+                    sys.stdout.flush()
+        except KeyboardInterrupt:
+            pass
+
+    print(f"{decoder.frames} frames, {decoder.lost} lost, {decoder.crc_errors} CRC errors, "
+          f"{unknown} unknown, {decoder.skipped} bytes skipped", file=sys.stderr)
+    return 0 if decoder.crc_errors == 0 else 2
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,399 @@
+// Host check and benchmark of the flat track tables and the transition table, see
+// track/flat_layout.hpp and track/transition.hpp.
+//
+// Builds the former track objects (straight and switch_track behind a vtable, allocated one by
+// one) from the same description as the flat tables and checks that the flat tables and the
+// transition table answer next_track(), next_tracks() and make_way_to() the same as the objects
+// for every track, every previous track and every switch state. Then it times the lookups of
+// random arrivals and the same walk as the simulation, a single train taking a pseudo random
+// way at every switch, over all three. It is built against the generated headers by
+// tools/CMakeLists.txt:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target trackbench
+//
+//   trackbench [steps]
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include "track/layout.hpp"
+#include "track/straight.hpp"
+#include "track/switch.hpp"
+
+namespace
+{
+    constexpr size_t N = track_table.size();
+    using table_type = transition_table<N>;
+
+    int failures = 0;
+
+    template <typename... Args>
+    void fail(const char *format, Args... args)
+    {
+        // The first few failures tell enough, a broken table fails for most previous tracks
+        if (++failures <= 10)
+        {
+            std::printf(format, args...);
+        }
+    }
+
+    using objects = std::array<std::shared_ptr<track>, N>;
+
+    /// @brief The track objects the way layout.hpp used to build them.
+    objects make_objects()
+    {
+        objects result;
+        for (const auto &d : layout_description)
+        {
+            if (d.type == track_type::Switch)
+            {
+                result[to_index(d.id)] = std::make_shared<switch_track>(d.id, d.power_pos, d.track_a, d.track_b, d.track_common, d.straight, d.curved);
+            }
+            else
+            {
+                result[to_index(d.id)] = std::make_shared<straight>(d.id, d.power_pos, d.track_a, d.track_b);
+            }
+        }
+        return result;
+    }
+
+    /// @brief Compares a row of the transition table with the objects in one switch state.
+    /// @param step The row of the arrival at the track.
+    /// @param next The next track the object returns in that state.
+    void check_transition(const objects &tracks, const transition &step, const trackid id, const switch_state state, const trackid next)
+    {
+        const auto i = to_index(id);
+        const auto previous = table_type::previous_of(track_table, static_cast<arrival>(&step - transitions.rows.data()));
+        const auto expected_arrival = next == trackid::INVALID ? invalid_arrival : table_type::arrival_of(track_table, next, id);
+        if (step.next_track[static_cast<size_t>(state)] != next or step.next_arrival[static_cast<size_t>(state)] != expected_arrival)
+        {
+            fail("FAIL transition of %zu from %d in state %d\n", i, static_cast<int>(previous), static_cast<int>(state));
+        }
+        auto *const switch_object = tracks[i]->type() == track_type::Switch ? static_cast<switch_track *>(tracks[i].get()) : nullptr;
+        for (size_t w = 0; w < step.ways.size(); ++w)
+        {
+            if (step.ways[w] == trackid::INVALID or not switch_object)
+            {
+                continue;
+            }
+            auto made = state;
+            table_type::make_way(step, w, made);
+            switch_object->state = state;
+            switch_object->make_way_to(step.ways[w], previous);
+            if (switch_object->state != made)
+            {
+                fail("FAIL make_way of %zu from %d to %d\n", i, static_cast<int>(previous), static_cast<int>(step.ways[w]));
+            }
+        }
+        if (switch_object)
+        {
+            switch_object->state = state;
+        }
+    }
+
+    /// @brief Compares the flat tables with the objects for all inputs of one track.
+    /// @details Every ID is tried as the previous track. The destination of make_way_to() is only
+    /// compared with the neighbours, so those, INVALID and the previous track cover all cases.
+    void check_track(const objects &tracks, const size_t i)
+    {
+        const auto id = static_cast<trackid>(i);
+        auto &object = *tracks[i];
+        auto *const switch_object = object.type() == track_type::Switch ? static_cast<switch_track *>(&object) : nullptr;
+        if (object.id != id or object.type() != track_table.type[i])
+        {
+            fail("FAIL track %zu has another ID or type\n", i);
+            return;
+        }
+        for (int p = -1; p < static_cast<int>(N); ++p)
+        {
+            const auto previous = static_cast<trackid>(p);
+            const auto ways = track_table.next_tracks(id, previous);
+            if (object.next_tracks(previous) != ways)
+            {
+                fail("FAIL next_tracks of %zu from %d\n", i, p);
+            }
+            const auto position = table_type::arrival_of(track_table, id, previous);
+            if (position == invalid_arrival and ways[0] != trackid::INVALID)
+            {
+                fail("FAIL no arrival at %zu from %d\n", i, p);
+            }
+            if (position != invalid_arrival and (transitions[position].ways[0] != ways[0] or transitions[position].ways[1] != ways[1] or
+                                                 ways[2] != trackid::INVALID))
+            {
+                fail("FAIL transition ways of %zu from %d\n", i, p);
+            }
+            for (const auto state : {switch_state::STRAIGHT, switch_state::CURVED, switch_state::UNKNOWN})
+            {
+                if (switch_object)
+                {
+                    switch_object->state = state;
+                }
+                const auto next = object.next_track(previous);
+                if (next != track_table.next_track(id, previous, state))
+                {
+                    fail("FAIL next_track of %zu from %d in state %d\n", i, p, static_cast<int>(state));
+                }
+                if (position != invalid_arrival)
+                {
+                    check_transition(tracks, transitions[position], id, state, next);
+                }
+                for (const auto to : {trackid::INVALID, track_table.track_a[i], track_table.track_b[i], track_table.track_common[i], previous})
+                {
+                    auto expected = state;
+                    const auto made = track_table.make_way_to(id, to, previous, expected);
+                    if (switch_object)
+                    {
+                        switch_object->state = state;
+                    }
+                    if (object.make_way_to(to, previous) != made or (switch_object and switch_object->state != expected))
+                    {
+                        fail("FAIL make_way_to of %zu from %d to %d\n", i, p, static_cast<int>(to));
+                    }
+                }
+            }
+        }
+    }
+
+    /// @brief Pseudo random choice of a way, the same sequence for every walk.
+    struct chooser
+    {
+        uint32_t state = 0x12345678;
+
+        bool next()
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state & 1;
+        }
+    };
+
+    /// @brief Result of a walk, the checksum covers the order of the tracks visited.
+    struct walk_result
+    {
+        uint32_t checksum;
+        double nanoseconds;
+    };
+
+    /// @brief Walks the track objects like the simulation used to, through the vtable.
+    walk_result walk_objects(const objects &tracks, const size_t steps)
+    {
+        chooser choose;
+        const track *last = tracks[to_index(track_table.track_a[0])].get();
+        track *current = tracks[0].get();
+        uint32_t checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t s = 0; s < steps; ++s)
+        {
+            const auto ways = current->next_tracks(last->id);
+            auto select = ways[0];
+            if (ways[1] != trackid::INVALID and choose.next())
+            {
+                select = ways[1];
+            }
+            current->make_way_to(select, last->id);
+            const auto next = current->next_track(last->id);
+            if (next == trackid::INVALID)
+            {
+                fail("FAIL the objects lead nowhere from %d\n", static_cast<int>(current->id));
+                break;
+            }
+            last = current;
+            current = tracks[to_index(next)].get();
+            checksum = checksum * 31 + static_cast<uint32_t>(next);
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return {checksum, elapsed.count() / double(steps)};
+    }
+
+    /// @brief The same walk over the transition table, following the arrivals.
+    walk_result walk_table(const size_t steps)
+    {
+        chooser choose;
+        track_state<N> state{};
+        auto position = table_type::arrival_of(track_table, static_cast<trackid>(0), track_table.track_a[0]);
+        uint32_t checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t s = 0; s < steps; ++s)
+        {
+            const auto &step = transitions[position];
+            const auto current = to_index(table_type::track_of(position));
+            auto current_switch = state.switches[current];
+            if (step.ways[1] != trackid::INVALID)
+            {
+                table_type::make_way(step, choose.next() ? 1 : 0, current_switch);
+            }
+            else
+            {
+                table_type::make_way(step, 0, current_switch);
+            }
+            state.set_switch(current, current_switch);
+            const auto next = step.next_arrival[static_cast<size_t>(current_switch)];
+            if (next == invalid_arrival)
+            {
+                fail("FAIL the transition table leads nowhere from %zu\n", current);
+                break;
+            }
+            position = next;
+            checksum = checksum * 31 + static_cast<uint32_t>(table_type::track_of(next));
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return {checksum, elapsed.count() / double(steps)};
+    }
+
+    /// @brief A lookup of the ways and the next track at one arrival.
+    struct query
+    {
+        trackid id;
+        trackid previous;
+        arrival position;
+    };
+
+    /// @brief Random arrivals in random switch states, the same for all three lookups.
+    std::vector<query> random_queries(objects &tracks, track_state<N> &state)
+    {
+        std::mt19937 random_generator(1);
+        std::uniform_int_distribution<size_t> pick(0, N * 3 - 1);
+        std::uniform_int_distribution<int> position(0, 1);
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (track_table.type[i] == track_type::Switch)
+            {
+                const auto setting = position(random_generator) ? switch_state::CURVED : switch_state::STRAIGHT;
+                static_cast<switch_track *>(tracks[i].get())->state = setting;
+                state.set_switch(i, setting);
+            }
+        }
+        std::vector<query> result;
+        while (result.size() < 4096)
+        {
+            const auto candidate = static_cast<arrival>(pick(random_generator));
+            const auto previous = table_type::previous_of(track_table, candidate);
+            if (previous != trackid::INVALID and table_type::arrival_of(track_table, table_type::track_of(candidate), previous) == candidate)
+            {
+                result.push_back({table_type::track_of(candidate), previous, candidate});
+            }
+        }
+        return result;
+    }
+
+    /// @brief Times a lookup over all queries, repeated until steps lookups are done.
+    template <typename Lookup>
+    double time_lookups(const std::vector<query> &queries, const size_t steps, uint32_t &checksum, Lookup &&lookup)
+    {
+        checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t s = 0; s < steps; s += queries.size())
+        {
+            for (const auto &q : queries)
+            {
+                checksum = checksum * 31 + lookup(q);
+            }
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / double((steps + queries.size() - 1) / queries.size() * queries.size());
+    }
+
+    /// @brief Prints the time of next_tracks() and next_track() at random arrivals.
+    void benchmark_lookups(objects &tracks, const size_t steps)
+    {
+        track_state<N> state{};
+        const auto queries = random_queries(tracks, state);
+        uint32_t objects_checksum = 0;
+        uint32_t flat_checksum = 0;
+        uint32_t table_checksum = 0;
+        const auto by_objects = time_lookups(queries, steps, objects_checksum, [&tracks](const query &q)
+                                             {
+                                                 const auto &object = *tracks[to_index(q.id)];
+                                                 const auto ways = object.next_tracks(q.previous);
+                                                 return static_cast<uint32_t>(ways[0]) + static_cast<uint32_t>(ways[1]) * 7 +
+                                                        static_cast<uint32_t>(object.next_track(q.previous)) * 13;
+                                             });
+        const auto by_flat = time_lookups(queries, steps, flat_checksum, [&state](const query &q)
+                                          {
+                                              const auto ways = track_table.next_tracks(q.id, q.previous);
+                                              const auto next = track_table.next_track(q.id, q.previous, state.switches[to_index(q.id)]);
+                                              return static_cast<uint32_t>(ways[0]) + static_cast<uint32_t>(ways[1]) * 7 +
+                                                     static_cast<uint32_t>(next) * 13;
+                                          });
+        const auto by_table = time_lookups(queries, steps, table_checksum, [&state](const query &q)
+                                           {
+                                               const auto &step = transitions[q.position];
+                                               const auto next = step.next_track[static_cast<size_t>(state.switches[to_index(q.id)])];
+                                               return static_cast<uint32_t>(step.ways[0]) + static_cast<uint32_t>(step.ways[1]) * 7 +
+                                                      static_cast<uint32_t>(next) * 13;
+                                           });
+        if (objects_checksum != flat_checksum or objects_checksum != table_checksum)
+        {
+            fail("FAIL the lookups give different tracks\n");
+        }
+        std::printf("lookups: objects %.2f ns, flat tables %.2f ns, transition table %.2f ns\n", by_objects, by_flat, by_table);
+    }
+
+    /// @brief The same walk over the flat tables, the switch states kept in a track_state.
+    walk_result walk_flat(const size_t steps)
+    {
+        chooser choose;
+        track_state<N> state{};
+        auto last = track_table.track_a[0];
+        auto current = static_cast<trackid>(0);
+        uint32_t checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t s = 0; s < steps; ++s)
+        {
+            const auto ways = track_table.next_tracks(current, last);
+            auto select = ways[0];
+            if (ways[1] != trackid::INVALID and choose.next())
+            {
+                select = ways[1];
+            }
+            auto current_switch = state.switches[to_index(current)];
+            track_table.make_way_to(current, select, last, current_switch);
+            state.set_switch(to_index(current), current_switch);
+            const auto next = track_table.next_track(current, last, current_switch);
+            if (next == trackid::INVALID)
+            {
+                fail("FAIL the flat tables lead nowhere from %d\n", static_cast<int>(current));
+                break;
+            }
+            last = current;
+            current = next;
+            checksum = checksum * 31 + static_cast<uint32_t>(next);
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return {checksum, elapsed.count() / double(steps)};
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t steps = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+    auto tracks = make_objects();
+    for (size_t i = 0; i < N; ++i)
+    {
+        check_track(tracks, i);
+    }
+    // The checks leave the switches in some state, the walks start with all of them unknown
+    tracks = make_objects();
+    const auto objects_walk = walk_objects(tracks, steps);
+    const auto flat_walk = walk_flat(steps);
+    const auto table_walk = walk_table(steps);
+    if (objects_walk.checksum != flat_walk.checksum or objects_walk.checksum != table_walk.checksum)
+    {
+        fail("FAIL the walks visit different tracks\n");
+    }
+    benchmark_lookups(tracks, steps);
+    if (failures)
+    {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    std::printf("%zu tracks, %zu steps, walk: objects %.2f ns, flat tables %.2f ns, transition table %.2f ns per step\n", N,
+                steps, objects_walk.nanoseconds, flat_walk.nanoseconds, table_walk.nanoseconds);
+    std::printf("The flat tables and the transition table match the track objects\n");
+    return 0;
+}
@@ -0,0 +1,194 @@
+// Host check and benchmark of the train engine, see track/train_engine.hpp.
+//
+// Places trains spread over the layout and runs them with random ways at the switches and
+// random turns. After every tick it checks that the occupancy bitmap and the power state hold
+// exactly the tracks of the trains, that no two trains share a track and that every train
+// reported as blocked or in a collision really has no way or an occupied track ahead. Then it
+// times the ticks for growing numbers of trains and reports the trains advanced per
+// millisecond, which should stay the same for any number of trains and any size of layout. It
+// is built against the generated headers by tools/CMakeLists.txt, tools/routebench.py builds it
+// for large synthetic layouts:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target trainbench
+//
+//   trainbench [seed]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "track/layout.hpp"
+#include "track/train_engine.hpp"
+
+namespace
+{
+    constexpr size_t N = track_table.size();
+    constexpr size_t max_trains = 1024;
+    using engine_type = train_engine<N, max_trains>;
+
+    std::mt19937 random_generator;
+    int failures = 0;
+
+    void expect(const bool condition, const char *what, const int line)
+    {
+        // The first few failures tell enough, a broken engine fails on every tick
+        if (not condition and ++failures <= 10)
+        {
+            std::printf("FAIL line %d: %s\n", line, what);
+        }
+    }
+#define EXPECT(condition) expect(condition, #condition, __LINE__)
+
+    /// @brief Places up to count trains, spread evenly over the tracks.
+    void place(engine_type &engine, const size_t count, const uint16_t speed)
+    {
+        const auto stride = N / count ? N / count : 1;
+        for (size_t i = 0; i < N and engine.size() < count; i += stride)
+        {
+            const auto id = static_cast<trackid>(i);
+            if (engine.add(id, track_table.track_a[i], speed) == engine_type::no_train)
+            {
+                engine.add(id, track_table.track_b[i], speed);
+            }
+        }
+    }
+
+    /// @brief Checks the occupancy, the power state and the status of every train after a tick.
+    /// @param before The occupancy before the tick. A train may have left the track ahead of a
+    /// train in a collision later in the same tick, with a speed of less than one track per tick
+    /// it was occupied before or is occupied now.
+    void check(const engine_type &engine, const track_state<N> &state, const word_bitset<N> &before)
+    {
+        std::vector<bool> seen(N);
+        for (size_t t = 0; t < engine.size(); ++t)
+        {
+            const auto current = to_index(engine.current_of(t));
+            EXPECT(not seen[current]);
+            seen[current] = true;
+            const auto &train = engine[t];
+            if (train.status == train_status::BLOCKED or train.status == train_status::COLLISION)
+            {
+                EXPECT(train.progress == engine_type::track_length);
+                const auto next = transitions[train.position].next_arrival[static_cast<size_t>(state.switches[current])];
+                if (train.status == train_status::BLOCKED)
+                {
+                    EXPECT(next == invalid_arrival);
+                }
+                else
+                {
+                    const auto ahead = to_index(transition_table<N>::track_of(next));
+                    EXPECT(next != invalid_arrival and (engine.occupancy().test(ahead) or before.test(ahead)));
+                }
+            }
+        }
+        for (size_t i = 0; i < N; ++i)
+        {
+            EXPECT(engine.occupancy().test(i) == seen[i]);
+            EXPECT((state.powerstate[i] == power::ON) == seen[i]);
+        }
+    }
+
+    /// @brief Runs trains with random ways, speeds and turns and checks every tick.
+    void stress(const size_t ticks)
+    {
+        track_state<N> state{};
+        engine_type engine(track_table, transitions, state);
+        place(engine, N / 3 + 1, 400);
+        std::uniform_int_distribution<int> way(0, 1);
+        std::uniform_int_distribution<int> event(0, 99);
+        std::uniform_int_distribution<uint16_t> speed(0, engine_type::track_length - 1);
+        size_t collisions = 0;
+        size_t blocked = 0;
+        for (size_t tick = 0; tick < ticks; ++tick)
+        {
+            for (size_t t = 0; t < engine.size(); ++t)
+            {
+                const auto e = event(random_generator);
+                if (e == 0)
+                {
+                    engine.set_speed(t, speed(random_generator));
+                }
+                else if (e == 1)
+                {
+                    const auto heading = engine[t].heading == direction::FORWARD ? direction::REVERSE : direction::FORWARD;
+                    const auto current = engine.current_of(t);
+                    if (engine.set_direction(t, heading))
+                    {
+                        EXPECT(engine.current_of(t) == current and engine[t].heading == heading);
+                    }
+                }
+            }
+            const auto before = engine.occupancy();
+            engine.tick([&way](size_t, const transition &) -> size_t
+                        { return static_cast<size_t>(way(random_generator)); });
+            for (size_t t = 0; t < engine.size(); ++t)
+            {
+                collisions += engine[t].status == train_status::COLLISION;
+                blocked += engine[t].status == train_status::BLOCKED;
+            }
+            check(engine, state, before);
+        }
+        std::printf("%zu trains, %zu ticks, %zu collisions and %zu blocked trains detected\n", engine.size(), ticks, collisions, blocked);
+    }
+
+    /// @brief Times the ticks with up to count trains.
+    void benchmark(const size_t count)
+    {
+        track_state<N> state{};
+        engine_type engine(track_table, transitions, state);
+        place(engine, count, 300);
+        if (engine.size() < count)
+        {
+            return;
+        }
+        // A cheap choice of the way, so mostly the engine is timed
+        uint32_t choice = 0x12345678;
+        const auto select = [&choice](size_t, const transition &) -> size_t
+        {
+            choice ^= choice << 13;
+            choice ^= choice >> 17;
+            choice ^= choice << 5;
+            return choice & 1;
+        };
+        const size_t ticks = 4000000 / count + 1;
+        size_t running = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t tick = 0; tick < ticks; ++tick)
+        {
+            engine.tick(select);
+            // Trains in a collision turn around, otherwise they soon all wait for each other. The
+            // turns are timed as well, they cost about as much as the scan of a tick.
+            for (size_t t = 0; t < engine.size(); ++t)
+            {
+                if (engine[t].status == train_status::COLLISION)
+                {
+                    engine.set_direction(t, engine[t].heading == direction::FORWARD ? direction::REVERSE : direction::FORWARD);
+                }
+                running += engine[t].status == train_status::RUNNING;
+            }
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        const auto advanced = double(ticks * engine.size());
+        std::printf("%5zu trains: %8.0f trains per ms, %6.1f ns per train and tick, %3.0f%% of them running\n", engine.size(),
+                    advanced / elapsed.count(), elapsed.count() * 1e6 / advanced, double(running) * 100 / advanced);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    random_generator.seed(argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 1);
+    stress(20000);
+    if (failures)
+    {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    std::printf("%zu tracks\n", N);
+    for (size_t count = 1; count <= max_trains and count <= N / 2; count *= 4)
+    {
+        benchmark(count);
+    }
+    std::printf("The train engine keeps the occupancy of all trains\n");
+    return 0;
+}
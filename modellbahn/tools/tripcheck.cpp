@@ -0,0 +1,136 @@
+// Host check of the recovery after overcurrent trips, see analog/trip_recovery.hpp.
+//
+// Drives the policy with a simulated clock through rows of trips and checks the backoff, the
+// lock out, the end of a row after a stable restart and the recorded trips:
+//
+//   cmake -S modellbahn/tools -B build-tools && cmake --build build-tools --target tripcheck
+
+#include <chrono>
+#include <cstdio>
+#include "analog/trip_recovery.hpp"
+
+namespace
+{
+    using namespace std::chrono_literals;
+
+    struct simulated_clock
+    {
+        using duration = std::chrono::microseconds;
+        using rep = duration::rep;
+        using period = duration::period;
+        using time_point = std::chrono::time_point<simulated_clock>;
+        static constexpr bool is_steady = true;
+    };
+
+    using recovery_type = trip_recovery<simulated_clock, 4>;
+    using time_point = simulated_clock::time_point;
+
+    int failures = 0;
+
+    void expect(const bool condition, const char *what, const int line)
+    {
+        if (not condition)
+        {
+            std::printf("FAIL line %d: %s\n", line, what);
+            ++failures;
+        }
+    }
+#define EXPECT(condition) expect(condition, #condition, __LINE__)
+
+    recovery_type::event trip_at(const time_point time, const uint16_t value = 3500)
+    {
+        return {.time = time, .latency = std::chrono::nanoseconds(200), .value = value};
+    }
+
+    /// @brief Restarts as soon as allowed, checking that it is not allowed earlier.
+    time_point restart(recovery_type &recovery)
+    {
+        const auto due = recovery.next_restart();
+        EXPECT(not recovery.restart_due(due - 1us));
+        EXPECT(recovery.state() == trip_state::TRIPPED);
+        EXPECT(recovery.restart_due(due));
+        EXPECT(recovery.state() == trip_state::ARMED);
+        return due;
+    }
+
+    void backoff_doubles_and_locks_out()
+    {
+        recovery_type recovery;
+        recovery.first_backoff = 10ms;
+        recovery.max_backoff = 50ms;
+        recovery.max_retries = 5;
+        auto now = time_point(10s);
+
+        const std::chrono::milliseconds expected[] = {10ms, 20ms, 40ms, 50ms, 50ms};
+        for (const auto backoff : expected)
+        {
+            recovery.trip(trip_at(now));
+            EXPECT(recovery.next_restart() - now == backoff);
+            // Short circuit still there, trips right after the restart
+            now = restart(recovery) + 100us;
+        }
+        recovery.trip(trip_at(now));
+        EXPECT(recovery.state() == trip_state::LOCKED_OUT);
+        EXPECT(not recovery.restart_due(now + 1h));
+        EXPECT(recovery.trips() == 6);
+
+        // Trips while locked out are ignored
+        recovery.trip(trip_at(now + 1s));
+        EXPECT(recovery.trips() == 6);
+
+        recovery.reset(now + 2s);
+        EXPECT(recovery.state() == trip_state::ARMED);
+        EXPECT(recovery.retries() == 0);
+        recovery.trip(trip_at(now + 2s + 1ms));
+        EXPECT(recovery.next_restart() - (now + 2s + 1ms) == 10ms);
+    }
+
+    void stable_restart_ends_row()
+    {
+        recovery_type recovery;
+        recovery.stable_time = 1s;
+        auto now = time_point(5s);
+
+        recovery.trip(trip_at(now));
+        now = restart(recovery) + 500ms;
+        recovery.trip(trip_at(now));
+        EXPECT(recovery.retries() == 2);
+        EXPECT(recovery.recent(0).retry == 2);
+
+        now = restart(recovery) + 1s;
+        recovery.trip(trip_at(now));
+        EXPECT(recovery.retries() == 1);
+        EXPECT(recovery.next_restart() - now == recovery.first_backoff);
+    }
+
+    void history_keeps_last_trips()
+    {
+        recovery_type recovery;
+        recovery.max_retries = 100;
+        auto now = time_point(1s);
+        for (uint16_t i = 0; i < 6; ++i)
+        {
+            auto e = trip_at(now, static_cast<uint16_t>(3000 + i));
+            e.latency = std::chrono::nanoseconds(100 + (i == 2 ? 900 : i));
+            recovery.trip(e);
+            now = restart(recovery) + 10ms;
+        }
+        EXPECT(recovery.trips() == 6);
+        EXPECT(recovery.recent(0).value == 3005);
+        EXPECT(recovery.recent(3).value == 3002);
+        EXPECT(recovery.worst_latency() == std::chrono::nanoseconds(1000));
+    }
+}
+
+int main()
+{
+    backoff_doubles_and_locks_out();
+    stable_restart_ends_row();
+    history_keeps_last_trips();
+    if (failures)
+    {
+        return 1;
+    }
+    std::printf("Trip recovery behaves as specified\n");
+    return 0;
+}
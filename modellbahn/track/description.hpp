@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "expansion/ioposition.hpp"
+#include "track/trackid.hpp"
+
+enum class power
+{
+    OFF,
+    ON,
+};
+enum class track_type
+{
+    Straight,
+    Switch,
+    Unknown
+};
+enum class switch_state : uint8_t
+{
+    STRAIGHT,
+    CURVED,
+    UNKNOWN,
+};
+
+/// @brief Converts a track ID into an index for the layout tables.
+/// @param id The unique identifier of the track.
+/// @return The table index of the track.
+constexpr size_t to_index(const trackid id)
+{
+    return static_cast<size_t>(id);
+}
+
+/// @brief Compile-time description of a single track.
+/// @details The flat layout tables and the track objects are both built from this description.
+struct track_description
+{
+    /// @brief The kind of track.
+    track_type type;
+
+    /// @brief The unique identifier of the track.
+    trackid id;
+
+    /// @brief The power position of the track.
+    ioposition power_pos;
+
+    /// @brief The first connected track.
+    trackid track_a;
+
+    /// @brief The second connected track.
+    trackid track_b;
+
+    /// @brief The common track of a switch, INVALID for straight tracks.
+    trackid track_common;
+
+    /// @brief The I/O position for the straight state of a switch.
+    ioposition straight;
+
+    /// @brief The I/O position for the curved state of a switch.
+    ioposition curved;
+
+    /// @brief True if the track has an occupancy sensor.
+    bool sensed;
+
+    /// @brief The input position of the occupancy sensor.
+    ioposition sense_pos;
+};
+
+/// @brief Describes a straight track connecting two other tracks.
+/// @param id The unique identifier of the track.
+/// @param power_pos The power position of the track.
+/// @param track_a The first connected track.
+/// @param track_b The second connected track.
+constexpr track_description make_straight(
+    const trackid id,
+    const ioposition &power_pos,
+    const trackid track_a,
+    const trackid track_b)
+{
+    return {
+        .type = track_type::Straight,
+        .id = id,
+        .power_pos = power_pos,
+        .track_a = track_a,
+        .track_b = track_b,
+        .track_common = trackid::INVALID,
+        .straight = {},
+        .curved = {},
+        .sensed = false,
+        .sense_pos = {},
+    };
+}
+
+/// @brief Describes a switch track connecting three other tracks.
+/// @param id The unique identifier of the track.
+/// @param power_pos The power position of the track.
+/// @param track_a The track reached in the straight state.
+/// @param track_b The track reached in the curved state.
+/// @param track_common The common track connected to both track_a and track_b.
+/// @param straight The I/O position for the straight state.
+/// @param curved The I/O position for the curved state.
+constexpr track_description make_switch(
+    const trackid id,
+    const ioposition &power_pos,
+    const trackid track_a,
+    const trackid track_b,
+    const trackid track_common,
+    const ioposition &straight,
+    const ioposition &curved)
+{
+    return {
+        .type = track_type::Switch,
+        .id = id,
+        .power_pos = power_pos,
+        .track_a = track_a,
+        .track_b = track_b,
+        .track_common = track_common,
+        .straight = straight,
+        .curved = curved,
+        .sensed = false,
+        .sense_pos = {},
+    };
+}
+
+/// @brief Adds an occupancy sensor to a track.
+/// @param description The track.
+/// @param sense_pos The input position of the sensor.
+constexpr track_description with_sensor(track_description description, const ioposition &sense_pos)
+{
+    description.sensed = true;
+    description.sense_pos = sense_pos;
+    return description;
+}
+
+/// @brief Checks that every track ID of a description is used exactly once.
+/// @details The flat tables are indexed by trackid, so the IDs must form the range 0..N-1.
+/// @param description The layout description.
+/// @return True if the description can be stored in flat tables.
+template <size_t N>
+constexpr bool is_indexable(const std::array<track_description, N> &description)
+{
+    std::array<bool, N> seen{};
+    for (const auto &d : description)
+    {
+        if (d.id == trackid::INVALID or to_index(d.id) >= N or seen[to_index(d.id)])
+        {
+            return false;
+        }
+        seen[to_index(d.id)] = true;
+    }
+    return true;
+}
@@ -0,0 +1,304 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include "description.hpp"
+#include "expansion/chain.hpp"
+#include "util/word_bitset.hpp"
+
+/// @brief Mutable state of all tracks of a layout.
+/// @details Kept apart from the constant topology so the tables of flat_layout can live in flash.
+/// Changes made through set_power() and set_switch() are recorded in a dirty bitset, so outputs
+/// only have to be updated for the tracks which changed.
+template <size_t N>
+struct track_state
+{
+    /// @brief The current power state of each track, change it with set_power().
+    std::array<power, N> powerstate = make_filled(power::OFF);
+
+    /// @brief The current state of each switch, UNKNOWN for straight tracks, change it with set_switch().
+    std::array<switch_state, N> switches = make_filled(switch_state::UNKNOWN);
+
+    /// @brief Sets the power state of a track.
+    constexpr void set_power(const size_t i, const power state)
+    {
+        if (powerstate[i] != state)
+        {
+            powerstate[i] = state;
+            dirty.set(i);
+        }
+    }
+
+    /// @brief Sets the state of a switch.
+    constexpr void set_switch(const size_t i, const switch_state state)
+    {
+        if (switches[i] != state)
+        {
+            switches[i] = state;
+            dirty.set(i);
+        }
+    }
+
+    /// @brief Calls a function with the index of every track changed since the last call.
+    template <typename Function>
+    constexpr void for_each_change(Function &&function)
+    {
+        const auto changed = dirty;
+        dirty.clear();
+        changed.for_each(function);
+    }
+
+private:
+    template <typename T>
+    static constexpr std::array<T, N> make_filled(const T value)
+    {
+        std::array<T, N> filled{};
+        filled.fill(value);
+        return filled;
+    }
+
+    static constexpr word_bitset<N> make_all_dirty()
+    {
+        word_bitset<N> all{};
+        for (size_t i = 0; i < N; ++i)
+        {
+            all.set(i);
+        }
+        return all;
+    }
+
+    /// @brief Tracks changed since the last for_each_change(), initially all of them.
+    word_bitset<N> dirty = make_all_dirty();
+};
+
+/// @brief Structure-of-arrays representation of the track topology.
+/// @details All tables are indexed by trackid. The object is meant to be built as constexpr
+/// from a track_description array, so it is placed in flash and traversal needs neither heap
+/// nor virtual calls. The semantics match straight and switch_track.
+template <size_t N>
+struct flat_layout
+{
+    /// @brief The kind of each track.
+    std::array<track_type, N> type{};
+
+    /// @brief The power position of each track.
+    std::array<ioposition, N> power_pos{};
+
+    /// @brief The first connected track.
+    std::array<trackid, N> track_a{};
+
+    /// @brief The second connected track.
+    std::array<trackid, N> track_b{};
+
+    /// @brief The common track of a switch, INVALID for straight tracks.
+    std::array<trackid, N> track_common{};
+
+    /// @brief The I/O position for the straight state of a switch.
+    std::array<ioposition, N> straight{};
+
+    /// @brief The I/O position for the curved state of a switch.
+    std::array<ioposition, N> curved{};
+
+    /// @brief The power output of each track, resolved at compile time.
+    std::array<output_bit, N> power_bit{};
+
+    /// @brief The output for the straight state of a switch, resolved at compile time.
+    std::array<output_bit, N> straight_bit{};
+
+    /// @brief The output for the curved state of a switch, resolved at compile time.
+    std::array<output_bit, N> curved_bit{};
+
+    /// @brief Tracks with an occupancy sensor.
+    word_bitset<N> sensed{};
+
+    /// @brief The input position of the occupancy sensor of each track.
+    std::array<ioposition, N> sense_pos{};
+
+    /// @brief The input of the occupancy sensor of each track, resolved at compile time.
+    std::array<input_bit, N> sense_bit{};
+
+    /// @brief Builds the tables from a layout description.
+    /// @param description The layout description, see is_indexable().
+    constexpr flat_layout(const std::array<track_description, N> &description)
+    {
+        for (const auto &d : description)
+        {
+            const auto i = to_index(d.id);
+            type[i] = d.type;
+            power_pos[i] = d.power_pos;
+            track_a[i] = d.track_a;
+            track_b[i] = d.track_b;
+            track_common[i] = d.track_common;
+            straight[i] = d.straight;
+            curved[i] = d.curved;
+            power_bit[i] = resolve_output(d.power_pos);
+            if (d.type == track_type::Switch)
+            {
+                straight_bit[i] = resolve_output(d.straight);
+                curved_bit[i] = resolve_output(d.curved);
+            }
+            if (d.sensed)
+            {
+                sensed.set(i);
+                sense_pos[i] = d.sense_pos;
+                sense_bit[i] = resolve_input(d.sense_pos);
+            }
+        }
+    }
+
+    /// @brief Checks that every I/O position exists in the expansion chain.
+    constexpr bool outputs_valid() const
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (not is_valid_output(power_pos[i]))
+            {
+                return false;
+            }
+            if (type[i] == track_type::Switch and not(is_valid_output(straight[i]) and is_valid_output(curved[i])))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Checks that every occupancy sensor exists in the expansion chain.
+    constexpr bool inputs_valid() const
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (sensed.test(i) and not is_valid_input(sense_pos[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Reads the occupancy sensors.
+    /// @param inputs The received buffer of an expansion chain.
+    /// @param chain The index of the chain, only the sensors on it are read.
+    /// @return One bit per track, set if the sensor of the track detects a train.
+    constexpr word_bitset<N> detect_occupancy(const uint8_t *inputs, const size_t chain = 0) const
+    {
+        word_bitset<N> detected{};
+        sensed.for_each(
+            [&](const size_t i)
+            {
+                if (sense_bit[i].chain == chain and inputs[sense_bit[i].index] & sense_bit[i].mask)
+                {
+                    detected.set(i);
+                }
+            });
+        return detected;
+    }
+
+    /// @brief The number of tracks in the layout.
+    static constexpr size_t size() { return N; }
+
+    /// @brief Determines the next track based on the previous track and the switch state.
+    /// @param id The ID of the current track.
+    /// @param previous The ID of the previous track.
+    /// @param state The state of the current track if it is a switch.
+    /// @return The ID of the next track.
+    constexpr trackid next_track(const trackid id, const trackid previous, const switch_state state) const
+    {
+        const auto i = to_index(id);
+        if (type[i] == track_type::Switch)
+        {
+            if (previous == track_common[i])
+            {
+                if (state == switch_state::STRAIGHT)
+                {
+                    return track_a[i];
+                }
+                else if (state == switch_state::CURVED)
+                {
+                    return track_b[i];
+                }
+            }
+            else if (previous == track_a[i] or previous == track_b[i])
+            {
+                return track_common[i];
+            }
+        }
+        else if (previous == track_a[i])
+        {
+            return track_b[i];
+        }
+        else if (previous == track_b[i])
+        {
+            return track_a[i];
+        }
+        return trackid::INVALID;
+    }
+
+    /// @brief Provides a list of possible next tracks.
+    /// @param id The ID of the current track.
+    /// @param previous The ID of the previous track.
+    /// @return An array of up to three possible next track IDs.
+    constexpr std::array<trackid, 3> next_tracks(const trackid id, const trackid previous) const
+    {
+        const auto i = to_index(id);
+        if (type[i] == track_type::Switch)
+        {
+            if (previous == track_common[i])
+            {
+                return {track_a[i], track_b[i], trackid::INVALID};
+            }
+            else if (previous == track_a[i] or previous == track_b[i])
+            {
+                return {track_common[i], trackid::INVALID, trackid::INVALID};
+            }
+        }
+        else if (previous == track_a[i])
+        {
+            return {track_b[i], trackid::INVALID, trackid::INVALID};
+        }
+        else if (previous == track_b[i])
+        {
+            return {track_a[i], trackid::INVALID, trackid::INVALID};
+        }
+        return {trackid::INVALID, trackid::INVALID, trackid::INVALID};
+    }
+
+    /// @brief Sets the switch state to create a path between two tracks.
+    /// @param id The ID of the current track.
+    /// @param to The ID of the destination track.
+    /// @param from The ID of the source track.
+    /// @param state The state of the current track, only modified for switches.
+    /// @return True if the state was successfully set, false otherwise.
+    constexpr bool make_way_to(const trackid id, const trackid to, const trackid from, switch_state &state) const
+    {
+        const auto i = to_index(id);
+        if (type[i] != track_type::Switch)
+        {
+            return true;
+        }
+        if (from == track_common[i])
+        {
+            if (to == track_a[i])
+            {
+                state = switch_state::STRAIGHT;
+            }
+            else if (to == track_b[i])
+            {
+                state = switch_state::CURVED;
+            }
+            return true;
+        }
+        else if (to == track_common[i])
+        {
+            if (from == track_a[i])
+            {
+                state = switch_state::STRAIGHT;
+            }
+            else if (from == track_b[i])
+            {
+                state = switch_state::CURVED;
+            }
+            return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include "flat_layout.hpp"
+#include "route.hpp"
+#include "transition.hpp"
+#include "util/word_bitset.hpp"
+
+/// @brief Runtime interlocking which keeps routes from claiming the same tracks or switches.
+/// @details A route is first set, which reserves its tracks and throws its switches, then
+/// locked while a train runs on it, which keeps its switches from being thrown, and finally
+/// released. The footprint of a route holds one bit per track it occupies (the source block,
+/// every track along the route and the destination block) followed by two bits per track for
+/// the switch positions it requires (straight, curved). It is walked from the route_table when
+/// a route is set or released, and a route may be set if its footprint does not intersect the
+/// reservations of the routes already set. So a check costs the length of the route plus one
+/// word-wide AND per 32 tracks, and no table of all routes or of their conflicts is needed.
+/// @tparam N The number of tracks.
+/// @tparam MaxRoutes The number of routes which can be set at the same time.
+template <size_t N, size_t MaxRoutes>
+class interlocking
+{
+public:
+    using footprint = word_bitset<N * 3>;
+
+    /// @brief Returned by set() if the route could not be set.
+    static constexpr size_t no_route = MaxRoutes;
+
+    /// @brief Bit of a track in the footprint.
+    static constexpr size_t segment_bit(const trackid id) { return to_index(id); }
+
+    /// @brief Bit of a switch position in the footprint.
+    static constexpr size_t position_bit(const trackid id, const switch_state state)
+    {
+        return N + to_index(id) * 2 + (state == switch_state::CURVED);
+    }
+
+    /// @brief Constructs the interlocking without any route set.
+    /// @param routes The routes between the blocks of the layout.
+    constexpr interlocking(const route_table &routes)
+        : routes(routes) {}
+
+    /// @brief The footprint of the route from a block to another block.
+    /// @param source The arrival at the source block.
+    /// @param destination The ID of the destination block.
+    /// @param result Receives the footprint, empty if there is no route.
+    /// @return False if there is no route.
+    constexpr bool footprint_of(const arrival source, const trackid destination, footprint &result) const
+    {
+        result.clear();
+        const auto length = routes.route(source, destination, [&result](const trackid id, const switch_state state)
+                                         {
+                                             result.set(segment_bit(id));
+                                             if (state != switch_state::UNKNOWN)
+                                             {
+                                                 result.set(position_bit(id, state));
+                                             }
+                                         });
+        if (length == 0)
+        {
+            result.clear();
+            return false;
+        }
+        result.set(segment_bit(transition_table<N>::track_of(source)));
+        return true;
+    }
+
+    /// @brief Sets a route if it does not share a track with any route already set.
+    /// @param source The arrival at the source block, giving the direction of travel.
+    /// @param destination The ID of the destination block.
+    /// @param state The layout state, the switches of the route are thrown.
+    /// @return The handle of the route, no_route if it does not exist, conflicts or MaxRoutes
+    /// routes are set.
+    constexpr size_t set(const arrival source, const trackid destination, track_state<N> &state)
+    {
+        footprint claimed;
+        if (not footprint_of(source, destination, claimed) or reserved.intersects(claimed))
+        {
+            return no_route;
+        }
+        size_t handle = 0;
+        while (handle < MaxRoutes and slots[handle].set)
+        {
+            ++handle;
+        }
+        if (handle == no_route)
+        {
+            return no_route;
+        }
+        slots[handle] = {.source = source, .destination = destination, .set = true, .locked = false};
+        reserved |= claimed;
+        routes.set_switches(source, destination, state);
+        return handle;
+    }
+
+    /// @brief Locks a route which is set, its switches must not be thrown until it is released.
+    /// @param handle The handle returned by set().
+    /// @return True if the route is locked.
+    constexpr bool lock(const size_t handle)
+    {
+        if (not is_set(handle))
+        {
+            return false;
+        }
+        footprint claimed;
+        footprint_of(slots[handle].source, slots[handle].destination, claimed);
+        slots[handle].locked = true;
+        locked |= claimed;
+        return true;
+    }
+
+    /// @brief Releases a route, locked or not, freeing its tracks and switches.
+    /// @param handle The handle returned by set(), it may be returned again by a later set().
+    /// @return True if the route was set.
+    constexpr bool release(const size_t handle)
+    {
+        if (not is_set(handle))
+        {
+            return false;
+        }
+        footprint claimed;
+        footprint_of(slots[handle].source, slots[handle].destination, claimed);
+        slots[handle] = {};
+        // Routes that are set never overlap, so the footprint can simply be removed
+        reserved.reset(claimed);
+        locked.reset(claimed);
+        return true;
+    }
+
+    /// @brief Checks if a route could be set right now.
+    constexpr bool is_free(const arrival source, const trackid destination) const
+    {
+        footprint claimed;
+        return footprint_of(source, destination, claimed) and not reserved.intersects(claimed);
+    }
+
+    constexpr bool is_set(const size_t handle) const { return handle < MaxRoutes and slots[handle].set; }
+
+    constexpr bool is_locked(const size_t handle) const { return handle < MaxRoutes and slots[handle].locked; }
+
+    /// @brief Checks if a track is reserved by any route that is set.
+    constexpr bool is_reserved(const trackid id) const
+    {
+        return reserved.test(segment_bit(id));
+    }
+
+    /// @brief Checks if a switch may be thrown, which is not the case while a locked route uses it.
+    constexpr bool can_throw(const trackid id) const
+    {
+        return not locked.test(segment_bit(id));
+    }
+
+    /// @brief The tracks and switch positions of all routes that are set.
+    constexpr const footprint &reservations() const { return reserved; }
+
+private:
+    /// @brief A route which is set, its footprint is walked again when needed.
+    struct reservation
+    {
+        arrival source = invalid_arrival;
+        trackid destination = trackid::INVALID;
+        bool set = false;
+        bool locked = false;
+    };
+
+    const route_table routes;
+
+    std::array<reservation, MaxRoutes> slots{};
+    footprint reserved{};
+    footprint locked{};
+};
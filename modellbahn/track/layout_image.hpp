@@ -0,0 +1,346 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <modm/math/utils/crc.hpp>
+#include "description.hpp"
+#include "expansion/chain.hpp"
+#include "layout_view.hpp"
+#include "route.hpp"
+#include "transition.hpp"
+
+/// @brief Tables stored in a layout image, in the order of layout_image_header::sections.
+enum class image_section : uint8_t
+{
+    /// @brief track_type of each track.
+    type,
+    /// @brief First connected track of each track.
+    track_a,
+    /// @brief Second connected track of each track.
+    track_b,
+    /// @brief Common track of each track, INVALID for straight tracks.
+    track_common,
+    /// @brief Power output of each track, resolved for the expansion chain.
+    power_bit,
+    /// @brief Output for the straight state of each switch.
+    straight_bit,
+    /// @brief Output for the curved state of each switch.
+    curved_bit,
+    /// @brief Input of the occupancy sensor of each track, an empty mask for tracks without one.
+    sense_bit,
+    /// @brief Transition table, three rows per track.
+    transitions,
+    /// @brief Block index of each track, see route_index::block_index.
+    block_index,
+    /// @brief Row of each switch in the next-hop table, see route_index::switch_index.
+    switch_index,
+    /// @brief The next-hop table of the routes, see route_table.
+    next_hops,
+    count,
+};
+
+/// @brief Location of one table in a layout image.
+struct image_table
+{
+    /// @brief Offset from the start of the image in bytes.
+    uint32_t offset;
+
+    /// @brief Number of entries.
+    uint32_t count;
+};
+
+/// @brief Header at the start of a layout image.
+/// @details All offsets are relative to the image, so it can be placed at any address.
+/// The image is little endian like the target and the host tool.
+struct layout_image_header
+{
+    static constexpr uint32_t image_magic = 0x494c424d; // "MBLI"
+    static constexpr uint16_t image_version = 4;
+
+    uint32_t magic;
+
+    /// @brief CRC32 of the image from the field after this one up to size.
+    uint32_t crc;
+
+    uint16_t version;
+
+    /// @brief Number of tracks.
+    uint16_t tracks;
+
+    /// @brief Number of blocks of the next-hop table.
+    uint16_t blocks;
+
+    /// @brief Number of expansion chains the output bits were resolved for.
+    uint16_t chains;
+
+    /// @brief Size of the image including this header.
+    uint32_t size;
+
+    /// @brief Sum of the frame sizes of all chains the output bits were resolved for.
+    uint32_t buffer_size;
+
+    std::array<image_table, static_cast<size_t>(image_section::count)> sections;
+};
+
+// The image is written on the host and read on the target, so the layout of every stored type is fixed
+static_assert(sizeof(layout_image_header) == 24 + 8 * static_cast<size_t>(image_section::count));
+static_assert(sizeof(track_type) == 4 and sizeof(trackid) == 2 and sizeof(output_bit) == 4);
+static_assert(sizeof(transition) == 18);
+
+/// @brief Zero-copy view of a layout image in flash.
+/// @details All tables are spans pointing into the image, nothing is parsed or copied. Open an
+/// image only after check() accepted it, which also validates every index stored in it, so the
+/// accessors need no further checks.
+class layout_image
+{
+public:
+    enum class status : uint8_t
+    {
+        OK,
+        /// @brief No image, the magic number is missing.
+        MISSING,
+        /// @brief The image was written in another format version.
+        BAD_VERSION,
+        /// @brief The image does not fit into the memory it was found in.
+        BAD_SIZE,
+        /// @brief The image is damaged.
+        BAD_CRC,
+        /// @brief A table is misplaced or has the wrong size.
+        BAD_TABLE,
+        /// @brief A table refers to a track, arrival or route entry that does not exist.
+        BAD_REFERENCE,
+        /// @brief The output bits were resolved for another expansion chain.
+        BAD_CHAIN,
+    };
+
+    /// @brief Creates an empty view without any tracks.
+    constexpr layout_image() = default;
+
+    /// @brief Validates an image.
+    /// @param data The start of the image.
+    /// @param capacity The size of the memory holding the image.
+    /// @param buffer_sizes The frame size of every expansion chain of the firmware, see chain_set::buffer_sizes.
+    static status check(const uint8_t *data, const size_t capacity, const std::span<const size_t> buffer_sizes)
+    {
+        layout_image_header header;
+        if (capacity < sizeof(header))
+        {
+            return status::MISSING;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != layout_image_header::image_magic)
+        {
+            return status::MISSING;
+        }
+        if (header.version != layout_image_header::image_version)
+        {
+            return status::BAD_VERSION;
+        }
+        if (header.size < sizeof(header) or header.size > capacity or reinterpret_cast<uintptr_t>(data) % alignof(layout_image_header))
+        {
+            return status::BAD_SIZE;
+        }
+        if (crc_of(data, header.size) != header.crc)
+        {
+            return status::BAD_CRC;
+        }
+        size_t buffer_size = 0;
+        for (const auto size : buffer_sizes)
+        {
+            buffer_size += size;
+        }
+        if (header.chains != buffer_sizes.size() or header.buffer_size != buffer_size)
+        {
+            return status::BAD_CHAIN;
+        }
+        const layout_image image(data);
+        if (not image.tables_valid())
+        {
+            return status::BAD_TABLE;
+        }
+        return image.references_valid(buffer_sizes) ? status::OK : status::BAD_REFERENCE;
+    }
+
+    /// @brief CRC32 as stored in layout_image_header::crc.
+    /// @param data The start of the image.
+    /// @param size The size of the image.
+    static uint32_t crc_of(const uint8_t *data, const size_t size)
+    {
+        constexpr size_t start = offsetof(layout_image_header, crc) + sizeof(uint32_t);
+        return modm::math::crc32(data + start, size - start);
+    }
+
+    /// @brief Opens an image which passed check().
+    static layout_image open(const uint8_t *data) { return layout_image(data); }
+
+    /// @brief The number of tracks, zero for an empty view.
+    size_t tracks() const { return header ? header->tracks : 0; }
+
+    /// @brief The number of blocks of the next-hop table.
+    size_t blocks() const { return header ? header->blocks : 0; }
+
+    std::span<const track_type> type() const { return table<track_type>(image_section::type); }
+    std::span<const trackid> track_a() const { return table<trackid>(image_section::track_a); }
+    std::span<const trackid> track_b() const { return table<trackid>(image_section::track_b); }
+    std::span<const trackid> track_common() const { return table<trackid>(image_section::track_common); }
+    std::span<const output_bit> power_bit() const { return table<output_bit>(image_section::power_bit); }
+    std::span<const output_bit> straight_bit() const { return table<output_bit>(image_section::straight_bit); }
+    std::span<const output_bit> curved_bit() const { return table<output_bit>(image_section::curved_bit); }
+    std::span<const input_bit> sense_bit() const { return table<input_bit>(image_section::sense_bit); }
+    std::span<const transition> transitions() const { return table<transition>(image_section::transitions); }
+    std::span<const uint16_t> block_index() const { return table<uint16_t>(image_section::block_index); }
+    std::span<const uint16_t> switch_index() const { return table<uint16_t>(image_section::switch_index); }
+    std::span<const uint8_t> next_hops() const { return table<uint8_t>(image_section::next_hops); }
+
+    /// @brief The routes between the blocks of the image.
+    route_table routes() const
+    {
+        return route_table(transitions(), block_index(), switch_index(), next_hops(), blocks());
+    }
+
+    /// @brief The tables of the image as seen by the train engine and the output updates.
+    layout_view view() const
+    {
+        layout_view result;
+        result.type = type();
+        result.track_a = track_a();
+        result.track_b = track_b();
+        result.track_common = track_common();
+        result.power_bit = power_bit();
+        result.straight_bit = straight_bit();
+        result.curved_bit = curved_bit();
+        result.sense_bit = sense_bit();
+        result.transitions = transitions();
+        return result;
+    }
+
+    /// @brief Finds the arrival at a track coming from one of its neighbours.
+    /// @return The arrival, invalid_arrival if the tracks are not connected.
+    arrival arrival_of(const trackid id, const trackid previous) const
+    {
+        return view().arrival_of(id, previous);
+    }
+
+private:
+    explicit layout_image(const uint8_t *data)
+        : data(data), header(reinterpret_cast<const layout_image_header *>(data)) {}
+
+    template <typename T>
+    std::span<const T> table(const image_section section) const
+    {
+        if (not header)
+        {
+            return {};
+        }
+        const auto &t = header->sections[static_cast<size_t>(section)];
+        return {reinterpret_cast<const T *>(data + t.offset), t.count};
+    }
+
+    /// @brief Checks the placement and size of every table.
+    bool tables_valid() const
+    {
+        const size_t n = header->tracks;
+        const std::array<size_t, static_cast<size_t>(image_section::count)> counts = {
+            n, n, n, n, n, n, n, n, n * 3, n, n, SIZE_MAX};
+        const std::array<size_t, static_cast<size_t>(image_section::count)> sizes = {
+            sizeof(track_type), sizeof(trackid), sizeof(trackid), sizeof(trackid), sizeof(output_bit), sizeof(output_bit),
+            sizeof(output_bit), sizeof(input_bit), sizeof(transition), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint8_t)};
+        const std::array<size_t, static_cast<size_t>(image_section::count)> alignments = {
+            alignof(track_type), alignof(trackid), alignof(trackid), alignof(trackid), alignof(output_bit), alignof(output_bit),
+            alignof(output_bit), alignof(input_bit), alignof(transition), alignof(uint16_t), alignof(uint16_t), alignof(uint8_t)};
+        for (size_t s = 0; s < counts.size(); ++s)
+        {
+            const auto &t = header->sections[s];
+            if ((counts[s] != SIZE_MAX and t.count != counts[s]) or t.offset < sizeof(layout_image_header) or t.offset % alignments[s] or
+                t.offset > header->size or t.count > (header->size - t.offset) / sizes[s])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Checks that every stored track, arrival, block, next hop and chain byte exists.
+    /// @param buffer_sizes The frame size of every chain, the bits index the buffer of their chain.
+    bool references_valid(const std::span<const size_t> buffer_sizes) const
+    {
+        const auto n = tracks();
+        size_t switches = 0;
+        const auto is_track = [n](const trackid id)
+        { return id != trackid::INVALID and to_index(id) < n; };
+        const auto is_link = [&is_track](const trackid id)
+        { return id == trackid::INVALID or is_track(id); };
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (not(is_link(track_a()[i]) and is_link(track_b()[i]) and is_link(track_common()[i])))
+            {
+                return false;
+            }
+            for (const auto &bit : {power_bit()[i], straight_bit()[i], curved_bit()[i], sense_bit()[i]})
+            {
+                if (bit.chain >= buffer_sizes.size() or bit.index >= buffer_sizes[bit.chain])
+                {
+                    return false;
+                }
+            }
+            if (block_index()[i] != no_block and block_index()[i] >= blocks())
+            {
+                return false;
+            }
+            // The routes look up the row of a switch entered through its common track
+            if (type()[i] == track_type::Switch)
+            {
+                if (switch_index()[i] != switches++)
+                {
+                    return false;
+                }
+            }
+            else if (switch_index()[i] != no_block)
+            {
+                return false;
+            }
+        }
+        if (next_hops().size() != switches * next_hop_stride(blocks()))
+        {
+            return false;
+        }
+        for (const auto entry : next_hops())
+        {
+            for (size_t shift = 0; shift < 8; shift += 2)
+            {
+                if (((entry >> shift) & 3) > static_cast<uint8_t>(switch_state::UNKNOWN))
+                {
+                    return false;
+                }
+            }
+        }
+        for (size_t a = 0; a < n * 3; ++a)
+        {
+            for (const auto next : transitions()[a].next_arrival)
+            {
+                if (next != invalid_arrival and next >= n * 3)
+                {
+                    return false;
+                }
+            }
+            for (const auto next : transitions()[a].next_track)
+            {
+                if (not is_link(next))
+                {
+                    return false;
+                }
+            }
+            // Only the common track of a switch leads two ways
+            if (transitions()[a].ways[1] != trackid::INVALID and (a % 3 != 2 or type()[a / 3] != track_type::Switch))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const uint8_t *data = nullptr;
+    const layout_image_header *header = nullptr;
+};
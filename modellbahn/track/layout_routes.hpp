@@ -0,0 +1,13 @@
+#pragma once
+#include "layout.hpp"
+#include "route.hpp"
+#include "track/route_hops.hpp"
+
+// Only included where routes are used, so the firmware carries no route tables it does not need
+
+/// @brief Block and switch numbers of the layout.
+static constexpr route_index<track_table.size()> route_rows(track_table);
+static_assert(route_next_hops.size() == route_rows.next_hop_size(), "The next-hop table was generated for another layout");
+
+/// @brief Shortest routes between all blocks of the layout.
+static constexpr route_table routes(transitions.rows, route_rows.block_index, route_rows.switch_index, route_next_hops, route_rows.blocks);
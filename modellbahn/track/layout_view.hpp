@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "flat_layout.hpp"
+#include "transition.hpp"
+#include "util/word_bitset.hpp"
+
+/// @brief Non-owning view of the tables of a layout.
+/// @details Refers either to the tables compiled into the firmware or to those of a layout
+/// image in flash, see layout_image::view(). The train engine and the output updates only go
+/// through the view, so a layout loaded at boot drives them without copying any table.
+struct layout_view
+{
+    /// @brief The kind of each track.
+    std::span<const track_type> type{};
+
+    /// @brief The first connected track.
+    std::span<const trackid> track_a{};
+
+    /// @brief The second connected track.
+    std::span<const trackid> track_b{};
+
+    /// @brief The common track of a switch, INVALID for straight tracks.
+    std::span<const trackid> track_common{};
+
+    /// @brief The power output of each track.
+    std::span<const output_bit> power_bit{};
+
+    /// @brief The output for the straight state of a switch.
+    std::span<const output_bit> straight_bit{};
+
+    /// @brief The output for the curved state of a switch.
+    std::span<const output_bit> curved_bit{};
+
+    /// @brief The input of the occupancy sensor of each track, an empty mask for tracks without one.
+    std::span<const input_bit> sense_bit{};
+
+    /// @brief The transition table, three rows per track.
+    std::span<const transition> transitions{};
+
+    /// @brief Creates an empty view without any tracks.
+    constexpr layout_view() = default;
+
+    /// @brief Views the tables compiled into the firmware.
+    template <size_t N>
+    constexpr layout_view(const flat_layout<N> &layout, const transition_table<N> &table)
+        : type(layout.type), track_a(layout.track_a), track_b(layout.track_b), track_common(layout.track_common),
+          power_bit(layout.power_bit), straight_bit(layout.straight_bit), curved_bit(layout.curved_bit),
+          sense_bit(layout.sense_bit), transitions(table.rows) {}
+
+    /// @brief The number of tracks.
+    constexpr size_t size() const { return type.size(); }
+
+    /// @brief The transition for an arrival.
+    constexpr const transition &operator[](const arrival position) const
+    {
+        return transitions[position];
+    }
+
+    /// @brief The ID of the track of an arrival.
+    static constexpr trackid track_of(const arrival position)
+    {
+        return static_cast<trackid>(position / 3);
+    }
+
+    /// @brief Finds the arrival at a track coming from one of its neighbours.
+    /// @return The arrival, invalid_arrival if the tracks are not connected.
+    constexpr arrival arrival_of(const trackid id, const trackid previous) const
+    {
+        if (id == trackid::INVALID or previous == trackid::INVALID or to_index(id) >= size())
+        {
+            return invalid_arrival;
+        }
+        const auto i = to_index(id);
+        // Same order of comparison as transition_table::arrival_of()
+        if (track_common[i] == previous)
+        {
+            return static_cast<arrival>(i * 3 + 2);
+        }
+        if (track_a[i] == previous)
+        {
+            return static_cast<arrival>(i * 3);
+        }
+        if (track_b[i] == previous)
+        {
+            return static_cast<arrival>(i * 3 + 1);
+        }
+        return invalid_arrival;
+    }
+
+    /// @brief The ID of the track an arrival came from.
+    constexpr trackid previous_of(const arrival position) const
+    {
+        const auto i = to_index(track_of(position));
+        switch (position % 3)
+        {
+        case 0:
+            return track_a[i];
+        case 1:
+            return track_b[i];
+        default:
+            return track_common[i];
+        }
+    }
+
+    /// @brief The tracks with an occupancy sensor.
+    /// @tparam N The capacity of the bitset, at least size().
+    template <size_t N>
+    constexpr word_bitset<N> sensed() const
+    {
+        word_bitset<N> result{};
+        for (size_t i = 0; i < size(); ++i)
+        {
+            result.set(i, sense_bit[i].mask != 0);
+        }
+        return result;
+    }
+
+    /// @brief Reads the occupancy sensors, same as flat_layout::detect_occupancy().
+    /// @param inputs The received buffer of an expansion chain.
+    /// @param chain The index of the chain, only the sensors on it are read.
+    /// @return One bit per track, set if the sensor of the track detects a train.
+    template <size_t N>
+    constexpr word_bitset<N> detect_occupancy(const uint8_t *inputs, const size_t chain = 0) const
+    {
+        word_bitset<N> detected{};
+        for (size_t i = 0; i < size(); ++i)
+        {
+            if (sense_bit[i].chain == chain and inputs[sense_bit[i].index] & sense_bit[i].mask)
+            {
+                detected.set(i);
+            }
+        }
+        return detected;
+    }
+};
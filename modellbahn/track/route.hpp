@@ -0,0 +1,217 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "flat_layout.hpp"
+#include "transition.hpp"
+
+/// @brief Position a switch has to be set to for a route.
+struct switch_setting
+{
+    /// @brief The ID of the switch track.
+    trackid id;
+
+    /// @brief The required state of the switch.
+    switch_state state;
+};
+
+/// @brief Marks tracks which are no block and tracks which are no switch.
+static constexpr uint16_t no_block = UINT16_MAX;
+
+/// @brief Number of entries of the next-hop table in one byte.
+static constexpr size_t hops_per_byte = 4;
+
+/// @brief Number of bytes of one row of the next-hop table.
+constexpr size_t next_hop_stride(const size_t blocks)
+{
+    return (blocks + hops_per_byte - 1) / hops_per_byte;
+}
+
+/// @brief Numbers the blocks and switches of a layout for the next-hop table.
+/// @details Every straight track is a block, the blocks and the switches are numbered in
+/// trackid order, the same way tools/layoutgen.py numbers them.
+template <size_t N>
+struct route_index
+{
+    /// @brief Number of blocks.
+    size_t blocks = 0;
+
+    /// @brief Number of switches, the rows of the next-hop table.
+    size_t switches = 0;
+
+    /// @brief Block index of each track, no_block for switches.
+    std::array<uint16_t, N> block_index{};
+
+    /// @brief Row of each switch in the next-hop table, no_block for other tracks.
+    std::array<uint16_t, N> switch_index{};
+
+    constexpr route_index(const flat_layout<N> &layout)
+    {
+        block_index.fill(no_block);
+        switch_index.fill(no_block);
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (layout.type[i] == track_type::Switch)
+            {
+                switch_index[i] = static_cast<uint16_t>(switches++);
+            }
+            else
+            {
+                block_index[i] = static_cast<uint16_t>(blocks++);
+            }
+        }
+    }
+
+    /// @brief The size of the next-hop table in bytes.
+    constexpr size_t next_hop_size() const { return switches * next_hop_stride(blocks); }
+};
+
+/// @brief Shortest directed routes between all blocks of a layout.
+/// @details Every straight track is a block and can be left in two directions: entered through
+/// track_a (heading to track_b) or through track_b. Direction through switches is respected, a
+/// train entering at the common track may continue on either branch, one entering on a branch
+/// only to the common track. So a train only has a choice at a switch entered through its
+/// common track, and the next-hop table stores that choice for every block it may head to:
+/// one row per switch, 2 bits per block with the switch_state, UNKNOWN if the block cannot be
+/// reached. Following the table from any block leads along a shortest route in number of
+/// tracks, see route(). The table is computed by tools/layoutgen.py and takes switches *
+/// blocks / 4 bytes, the route of a request is walked at runtime in as many steps as it is long.
+/// The tables are only referenced, so the same code works on the compiled layout and on a
+/// layout image.
+class route_table
+{
+public:
+    /// @brief Creates an empty table without any blocks.
+    constexpr route_table() = default;
+
+    /// @param transitions The transition table of the layout.
+    /// @param block_index The block index of each track, see route_index.
+    /// @param switch_index The row of each switch, see route_index.
+    /// @param next_hops The next-hop table, see tools/layoutgen.py.
+    /// @param blocks The number of blocks.
+    constexpr route_table(const std::span<const transition> transitions, const std::span<const uint16_t> block_index,
+                          const std::span<const uint16_t> switch_index, const std::span<const uint8_t> next_hops, const size_t blocks)
+        : transitions(transitions), block_index(block_index), switch_index(switch_index), next_hops(next_hops), block_count(blocks) {}
+
+    /// @brief The number of blocks.
+    constexpr size_t blocks() const { return block_count; }
+
+    /// @brief Checks if a track is a block.
+    constexpr bool is_block(const trackid id) const
+    {
+        return id != trackid::INVALID and to_index(id) < block_index.size() and block_index[to_index(id)] != no_block;
+    }
+
+    /// @brief The way to take at a switch entered through its common track to reach a block.
+    /// @param at The ID of the switch.
+    /// @param destination The ID of the destination block.
+    /// @return STRAIGHT or CURVED, UNKNOWN if the block cannot be reached.
+    constexpr switch_state next_hop(const trackid at, const trackid destination) const
+    {
+        const auto row = switch_index[to_index(at)];
+        const auto block = block_index[to_index(destination)];
+        const auto entry = next_hops[row * next_hop_stride(block_count) + block / hops_per_byte];
+        return static_cast<switch_state>((entry >> (2 * (block % hops_per_byte))) & 3);
+    }
+
+    /// @brief Walks the shortest route from a block to another block.
+    /// @param source The arrival at the source block, giving the direction of travel.
+    /// @param destination The ID of the destination block.
+    /// @param visit Called as visit(id, state) with every track after the source block up to
+    /// the destination block, state is the switch_state the route needs at the track or UNKNOWN.
+    /// @return The number of tracks visited, zero if there is no route. Then visit may have
+    /// been called with the tracks up to the point the walk failed.
+    template <typename Visitor>
+    constexpr size_t route(const arrival source, const trackid destination, Visitor &&visit) const
+    {
+        if (not valid(source, destination))
+        {
+            return 0;
+        }
+        // A route never enters the same arrival twice, a longer walk circles without reaching the destination
+        auto current = source;
+        for (size_t length = 1; length <= transitions.size(); ++length)
+        {
+            const auto &step = transitions[current];
+            size_t way = 0;
+            if (step.ways[1] != trackid::INVALID)
+            {
+                const auto hop = next_hop(track_of(current), destination);
+                if (hop == switch_state::UNKNOWN)
+                {
+                    return 0;
+                }
+                way = hop == switch_state::CURVED;
+            }
+            if (step.ways[way] == trackid::INVALID)
+            {
+                return 0;
+            }
+            const auto state = step.way_state[way];
+            if (current != source)
+            {
+                visit(track_of(current), state);
+            }
+            current = step.next_arrival[static_cast<size_t>(state == switch_state::UNKNOWN ? switch_state::STRAIGHT : state)];
+            if (current == invalid_arrival)
+            {
+                return 0;
+            }
+            if (track_of(current) == destination)
+            {
+                visit(destination, switch_state::UNKNOWN);
+                return length;
+            }
+        }
+        return 0;
+    }
+
+    /// @brief The number of tracks of the shortest route from a block to another block.
+    /// @return The number of tracks after the source block up to the destination block, zero if there is no route.
+    constexpr size_t length(const arrival source, const trackid destination) const
+    {
+        return route(source, destination, [](trackid, switch_state) {});
+    }
+
+    /// @brief Sets all switches of a route, same as make_way_to() along the route.
+    /// @param source The arrival at the source block.
+    /// @param destination The ID of the destination block.
+    /// @param state The state of the layout.
+    /// @return False if there is no route, then nothing was set.
+    template <size_t N>
+    constexpr bool set_switches(const arrival source, const trackid destination, track_state<N> &state) const
+    {
+        if (length(source, destination) == 0)
+        {
+            return false;
+        }
+        route(source, destination, [&state](const trackid id, const switch_state setting)
+              {
+                  if (setting != switch_state::UNKNOWN)
+                  {
+                      state.set_switch(to_index(id), setting);
+                  }
+              });
+        return true;
+    }
+
+private:
+    static constexpr trackid track_of(const arrival position)
+    {
+        return static_cast<trackid>(position / 3);
+    }
+
+    /// @brief Checks that the source is an arrival at a block and the destination another block.
+    constexpr bool valid(const arrival source, const trackid destination) const
+    {
+        return source < transitions.size() and source % 3 != 2 and is_block(track_of(source)) and
+               is_block(destination) and destination != track_of(source);
+    }
+
+    std::span<const transition> transitions{};
+    std::span<const uint16_t> block_index{};
+    std::span<const uint16_t> switch_index{};
+    std::span<const uint8_t> next_hops{};
+    size_t block_count = 0;
+};
@@ -10,7 +10,7 @@ struct straight : public track
     /// @param power_pos The power position of the track.
     /// @param track_a The first connected track.
     /// @param track_b The second connected track.
-    straight(
+    constexpr straight(
         trackid id,
         const ioposition &power_pos,
         const trackid track_a,
@@ -2,13 +2,6 @@
 
 #include "track.hpp"
 
-enum class switch_state
-{
-    STRAIGHT,
-    CURVED,
-    UNKNOWN,
-};
-
 /// @brief Represents a switch track with multiple possible states.
 /// @details A switch track can connect three tracks and has a state to determine the active connection.
 struct switch_track : public track
@@ -24,7 +17,7 @@ struct switch_track : public track
     /// @param track_common The common track connected to both track_a and track_b.
     /// @param straight The I/O position for the straight state.
     /// @param curved The I/O position for the curved state.
-    switch_track(
+    constexpr switch_track(
         trackid id,
         const ioposition &power_pos,
         const trackid track_a,
@@ -1,19 +1,6 @@
 #pragma once
 #include <cstddef>
-#include "expansion/controller.hpp"
-#include "trackid.hpp"
-
-enum class power
-{
-    OFF,
-    ON,
-};
-enum class track_type
-{
-    Straight,
-    Switch,
-    Unknown
-};
+#include "description.hpp"
 
 /// @brief Base class for all track types.
 /// @details Provides a common interface for different types of tracks.
@@ -32,7 +19,7 @@ struct track
     /// @param id The unique identifier of the track.
     /// @param power_pos The power position of the track.
     /// @param length The length of the track.
-    track(
+    constexpr track(
         trackid id,
         const ioposition &power_pos)
         : id(id),
@@ -40,7 +27,7 @@ struct track
           powerstate(power::OFF) {}
 
     /// @brief Virtual destructor for the track class.
-    virtual ~track() = default;
+    constexpr virtual ~track() = default;
 
     virtual track_type type() const = 0;
 
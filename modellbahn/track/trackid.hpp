@@ -1,27 +0,0 @@
-#pragma once
-enum class trackid
-{
-    INVALID = -1,
-    A_d,
-    A_c,
-    A_1a,
-    A_1b,
-    A_a,
-    A_2a,
-    A_2b,
-    A_b,
-    A_3a,
-    A_3b,
-    B_1a,
-    C_a,
-    C_1a,
-    C_1b,
-    C_2a,
-    C_2b,
-    C_b,
-    C_c,
-    C_3a,
-    C_3b,
-    C_3c,
-    D_1a,
-};
\ No newline at end of file
@@ -0,0 +1,261 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "flat_layout.hpp"
+#include "layout_view.hpp"
+#include "transition.hpp"
+#include "util/word_bitset.hpp"
+
+enum class train_status : uint8_t
+{
+    /// @brief The train has no speed set.
+    STOPPED,
+    /// @brief The train is moving.
+    RUNNING,
+    /// @brief The way ahead ends or a switch is not set, the train waits at the end of its track.
+    BLOCKED,
+    /// @brief The track ahead is occupied, the train waits at the end of its track.
+    COLLISION,
+};
+
+enum class direction : uint8_t
+{
+    FORWARD,
+    REVERSE,
+};
+
+/// @brief State of a single train in the train_engine.
+struct train
+{
+    /// @brief Arrival at the current track, gives the direction of travel.
+    arrival position;
+
+    /// @brief Distance travelled on the current track, up to train_engine::track_length.
+    uint16_t progress;
+
+    /// @brief Distance travelled per tick.
+    uint16_t speed;
+
+    /// @brief The direction relative to the direction the train was added with.
+    direction heading;
+
+    /// @brief The result of the last tick.
+    train_status status;
+
+    /// @brief Number of tracks entered during the last tick.
+    uint8_t steps;
+};
+
+/// @brief Advances several trains per tick over the transition table.
+/// @details Every train occupies the track it is on, which is tracked in an occupancy bitmap
+/// and mirrored into the power state of the layout. A train only enters the next track if it
+/// exists and is not occupied, otherwise it waits at the end of its track and reports
+/// BLOCKED or COLLISION. A tick only touches the trains, so its cost grows with the number of
+/// trains and not with the size of the layout. The tables are read through a layout_view, so
+/// the engine runs on the compiled layout or on a layout image with up to N tracks. The engine
+/// does not depend on modm.
+template <size_t N, size_t MaxTrains>
+class train_engine
+{
+public:
+    /// @brief Length of every track in the units of train::speed.
+    static constexpr uint16_t track_length = 1024;
+
+    /// @brief Returned by add() if the train could not be placed.
+    static constexpr size_t no_train = MaxTrains;
+
+    /// @brief Constructs an engine without trains.
+    /// @param layout The flat layout tables.
+    /// @param transitions The transition table of the layout.
+    /// @param state The layout state, switches are thrown and power is set by the trains.
+    constexpr train_engine(const flat_layout<N> &layout, const transition_table<N> &transitions, track_state<N> &state)
+        : layout(layout, transitions), state(state) {}
+
+    /// @brief Constructs an engine without trains.
+    /// @param layout The tables of the layout, at most N tracks.
+    /// @param state The layout state, switches are thrown and power is set by the trains.
+    constexpr train_engine(const layout_view &layout, track_state<N> &state)
+        : layout(layout), state(state) {}
+
+    /// @brief Runs the trains on other tables, e.g. those of a layout image.
+    /// @param tables The tables of the layout.
+    /// @return False if trains are placed already or the layout has more than N tracks.
+    constexpr bool use(const layout_view &tables)
+    {
+        if (count != 0 or tables.size() > N)
+        {
+            return false;
+        }
+        layout = tables;
+        return true;
+    }
+
+    /// @brief The tables the trains run on.
+    constexpr const layout_view &tables() const { return layout; }
+
+    /// @brief Places a new train.
+    /// @param current The ID of the track the train is on.
+    /// @param previous The ID of the track the train came from.
+    /// @param speed The distance travelled per tick.
+    /// @return The index of the train, no_train if the track is occupied or not connected.
+    constexpr size_t add(const trackid current, const trackid previous, const uint16_t speed)
+    {
+        const auto position = layout.arrival_of(current, previous);
+        if (count >= MaxTrains or position == invalid_arrival or occupied.test(to_index(current)))
+        {
+            return no_train;
+        }
+        trains[count] = {
+            .position = position,
+            .progress = 0,
+            .speed = speed,
+            .heading = direction::FORWARD,
+            .status = speed ? train_status::RUNNING : train_status::STOPPED,
+            .steps = 0,
+        };
+        occupy(to_index(current));
+        return count++;
+    }
+
+    /// @brief Sets the speed of a train.
+    constexpr void set_speed(const size_t index, const uint16_t speed)
+    {
+        trains[index].speed = speed;
+    }
+
+    /// @brief Sets the direction of a train, turning it around on its track if needed.
+    /// @return False if the train cannot turn because the way behind it is not set.
+    constexpr bool set_direction(const size_t index, const direction heading)
+    {
+        auto &t = trains[index];
+        if (t.heading == heading)
+        {
+            return true;
+        }
+        const auto current = layout.track_of(t.position);
+        const auto &step = layout[t.position];
+        const auto ahead = step.next_track[static_cast<size_t>(state.switches[to_index(current)])];
+        const auto turned = layout.arrival_of(current, ahead);
+        if (turned == invalid_arrival)
+        {
+            return false;
+        }
+        t.position = turned;
+        t.progress = static_cast<uint16_t>(track_length - t.progress);
+        t.heading = heading;
+        return true;
+    }
+
+    /// @brief Advances all trains by their speed.
+    /// @param select Called as select(index, step) when a train leaves a track with two possible
+    /// ways, returns the index into transition::ways to take.
+    template <typename Selector>
+    constexpr void tick(Selector &&select)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto &t = trains[i];
+            t.steps = 0;
+            if (t.speed == 0)
+            {
+                t.status = train_status::STOPPED;
+                continue;
+            }
+            t.status = train_status::RUNNING;
+            uint32_t progress = t.progress + t.speed;
+            while (progress >= track_length)
+            {
+                const auto current = to_index(layout.track_of(t.position));
+                const auto &step = layout[t.position];
+                auto current_switch = state.switches[current];
+                if (step.ways[1] != trackid::INVALID)
+                {
+                    transition_table<N>::make_way(step, select(i, step), current_switch);
+                }
+                else if (step.ways[0] != trackid::INVALID)
+                {
+                    transition_table<N>::make_way(step, 0, current_switch);
+                }
+                state.set_switch(current, current_switch);
+
+                const auto next = step.next_arrival[static_cast<size_t>(current_switch)];
+                if (next == invalid_arrival)
+                {
+                    t.status = train_status::BLOCKED;
+                    progress = track_length;
+                    break;
+                }
+                const auto next_index = to_index(layout.track_of(next));
+                if (occupied.test(next_index) or detected.test(next_index))
+                {
+                    t.status = train_status::COLLISION;
+                    progress = track_length;
+                    break;
+                }
+                release(current);
+                occupy(next_index);
+                t.position = next;
+                progress -= track_length;
+                ++t.steps;
+            }
+            t.progress = static_cast<uint16_t>(progress);
+        }
+    }
+
+    /// @brief Advances all trains, taking the first way at every switch.
+    constexpr void tick()
+    {
+        tick([](size_t, const transition &) -> size_t
+             { return 0; });
+    }
+
+    /// @brief The number of trains placed.
+    constexpr size_t size() const { return count; }
+
+    constexpr const train &operator[](const size_t index) const { return trains[index]; }
+
+    /// @brief The ID of the track a train is on.
+    constexpr trackid current_of(const size_t index) const
+    {
+        return layout.track_of(trains[index].position);
+    }
+
+    /// @brief The ID of the track a train came from.
+    constexpr trackid previous_of(const size_t index) const
+    {
+        return layout.previous_of(trains[index].position);
+    }
+
+    /// @brief One bit per track, set if a train is on the track.
+    constexpr const word_bitset<N> &occupancy() const { return occupied; }
+
+    /// @brief Sets the occupancy reported by the track sensors, see flat_layout::detect_occupancy().
+    /// @details Trains do not enter a detected track either, which also stops them in front of
+    /// anything on the layout the engine does not know about.
+    constexpr void set_detected(const word_bitset<N> &sensors)
+    {
+        detected = sensors;
+    }
+
+private:
+    constexpr void occupy(const size_t i)
+    {
+        occupied.set(i);
+        state.set_power(i, power::ON);
+    }
+
+    constexpr void release(const size_t i)
+    {
+        occupied.reset(i);
+        state.set_power(i, power::OFF);
+    }
+
+    layout_view layout;
+    track_state<N> &state;
+
+    std::array<train, MaxTrains> trains{};
+    size_t count = 0;
+    word_bitset<N> occupied{};
+    word_bitset<N> detected{};
+};
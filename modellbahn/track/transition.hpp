@@ -0,0 +1,200 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "flat_layout.hpp"
+
+/// @brief Arrival at a track through one of its connections.
+/// @details Encoded as track index * 3 + connection, see transition_table::arrival_of().
+using arrival = uint16_t;
+
+/// @brief Marks an arrival that does not exist in the layout.
+static constexpr arrival invalid_arrival = UINT16_MAX;
+
+/// @brief Precomputed result of entering a track through one connection.
+/// @details All arrays indexed by switch_state hold the same value for straight tracks and
+/// trailing switch moves, so a walker can index them unconditionally.
+struct transition
+{
+    /// @brief The next track for each switch_state, same as flat_layout::next_track().
+    std::array<trackid, 3> next_track;
+
+    /// @brief The arrival at the next track for each switch_state.
+    std::array<arrival, 3> next_arrival;
+
+    /// @brief The possible next tracks, same as the first two of flat_layout::next_tracks().
+    std::array<trackid, 2> ways;
+
+    /// @brief The switch_state which makes the way to ways[i], UNKNOWN if nothing has to be set.
+    std::array<switch_state, 2> way_state;
+};
+
+/// @brief Transition table answering next_track and next_tracks with one indexed load.
+/// @details Built at compile time from a flat_layout. Three rows are reserved per track,
+/// one for every connection (track_a, track_b, track_common).
+template <size_t N>
+struct transition_table
+{
+    static_assert(N * 3 < invalid_arrival, "Layout too large for the arrival encoding");
+
+    enum connection : uint8_t
+    {
+        via_a = 0,
+        via_b = 1,
+        via_common = 2,
+    };
+
+    /// @brief One row for each possible arrival.
+    std::array<transition, N * 3> rows{};
+
+    /// @brief Builds the table from the flat layout tables.
+    /// @param layout The layout to precompute.
+    constexpr transition_table(const flat_layout<N> &layout)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            const auto id = static_cast<trackid>(i);
+            for (const auto via : {via_a, via_b, via_common})
+            {
+                auto &row = rows[i * 3 + via];
+                const auto previous = neighbour(layout, i, via);
+                for (const auto state : {switch_state::STRAIGHT, switch_state::CURVED, switch_state::UNKNOWN})
+                {
+                    const auto next = previous == trackid::INVALID ? trackid::INVALID : layout.next_track(id, previous, state);
+                    row.next_track[static_cast<size_t>(state)] = next;
+                    row.next_arrival[static_cast<size_t>(state)] = next == trackid::INVALID ? invalid_arrival : arrival_of(layout, next, id);
+                }
+                const auto ways = previous == trackid::INVALID ? std::array<trackid, 3>{trackid::INVALID, trackid::INVALID, trackid::INVALID} : layout.next_tracks(id, previous);
+                for (size_t w = 0; w < row.ways.size(); ++w)
+                {
+                    row.ways[w] = ways[w];
+                    row.way_state[w] = switch_state::UNKNOWN;
+                    if (ways[w] != trackid::INVALID)
+                    {
+                        layout.make_way_to(id, ways[w], previous, row.way_state[w]);
+                    }
+                }
+            }
+        }
+    }
+
+    /// @brief Finds the arrival at a track coming from one of its neighbours.
+    /// @details Only needed to enter the table, walkers then follow next_arrival.
+    /// @param layout The layout the table was built from.
+    /// @param id The ID of the track entered.
+    /// @param previous The ID of the track coming from.
+    /// @return The arrival, invalid_arrival if the tracks are not connected.
+    static constexpr arrival arrival_of(const flat_layout<N> &layout, const trackid id, const trackid previous)
+    {
+        if (id == trackid::INVALID or previous == trackid::INVALID)
+        {
+            return invalid_arrival;
+        }
+        const auto i = to_index(id);
+        // Same order of comparison as flat_layout::next_track()
+        for (const auto via : {via_common, via_a, via_b})
+        {
+            if (neighbour(layout, i, via) == previous)
+            {
+                return static_cast<arrival>(i * 3 + via);
+            }
+        }
+        return invalid_arrival;
+    }
+
+    /// @brief The ID of the track of an arrival.
+    static constexpr trackid track_of(const arrival position)
+    {
+        return static_cast<trackid>(position / 3);
+    }
+
+    /// @brief The ID of the track an arrival came from.
+    /// @param layout The layout the table was built from.
+    /// @param position The arrival.
+    static constexpr trackid previous_of(const flat_layout<N> &layout, const arrival position)
+    {
+        return neighbour(layout, to_index(track_of(position)), static_cast<connection>(position % 3));
+    }
+
+    /// @brief The transition for an arrival.
+    constexpr const transition &operator[](const arrival position) const
+    {
+        return rows[position];
+    }
+
+    /// @brief Sets the switch state to make the way to one of the possible next tracks.
+    /// @param step The transition of the current arrival.
+    /// @param way The index into transition::ways.
+    /// @param state The state of the current track.
+    static constexpr void make_way(const transition &step, const size_t way, switch_state &state)
+    {
+        if (step.way_state[way] != switch_state::UNKNOWN)
+        {
+            state = step.way_state[way];
+        }
+    }
+
+    /// @brief Checks the table against the branching implementation of flat_layout.
+    /// @details Any previous track which is not a neighbour behaves like INVALID in both,
+    /// so checking the neighbours and INVALID covers every input.
+    /// @param layout The layout the table was built from.
+    /// @return True if both give the same answers for all inputs.
+    constexpr bool matches(const flat_layout<N> &layout) const
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            const auto id = static_cast<trackid>(i);
+            for (const auto previous : {trackid::INVALID, layout.track_a[i], layout.track_b[i], layout.track_common[i]})
+            {
+                const auto position = arrival_of(layout, id, previous);
+                const auto ways = layout.next_tracks(id, previous);
+                if (position == invalid_arrival)
+                {
+                    if (ways[0] != trackid::INVALID)
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                const auto &step = rows[position];
+                if (step.ways[0] != ways[0] or step.ways[1] != ways[1] or ways[2] != trackid::INVALID)
+                {
+                    return false;
+                }
+                for (const auto state : {switch_state::STRAIGHT, switch_state::CURVED, switch_state::UNKNOWN})
+                {
+                    if (step.next_track[static_cast<size_t>(state)] != layout.next_track(id, previous, state))
+                    {
+                        return false;
+                    }
+                    for (size_t w = 0; w < step.ways.size(); ++w)
+                    {
+                        auto expected = state;
+                        auto actual = state;
+                        layout.make_way_to(id, step.ways[w], previous, expected);
+                        make_way(step, w, actual);
+                        if (step.ways[w] != trackid::INVALID and expected != actual)
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr trackid neighbour(const flat_layout<N> &layout, const size_t i, const connection via)
+    {
+        switch (via)
+        {
+        case via_a:
+            return layout.track_a[i];
+        case via_b:
+            return layout.track_b[i];
+        default:
+            return layout.track_common[i];
+        }
+    }
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Fixed size bitset stored in 32 bit words.
+/// @details Unlike std::bitset it is usable in constant expressions and gives access to the
+/// words, so set operations compile to one instruction per 32 bits.
+template <size_t Bits>
+struct word_bitset
+{
+    using word = uint32_t;
+    static constexpr size_t word_bits = 32;
+    static constexpr size_t word_count = (Bits + word_bits - 1) / word_bits;
+
+    std::array<word, word_count> words{};
+
+    static constexpr size_t size() { return Bits; }
+
+    constexpr bool test(const size_t bit) const
+    {
+        return words[bit / word_bits] & (word(1) << (bit % word_bits));
+    }
+
+    constexpr void set(const size_t bit)
+    {
+        words[bit / word_bits] |= word(1) << (bit % word_bits);
+    }
+
+    constexpr void set(const size_t bit, const bool value)
+    {
+        value ? set(bit) : reset(bit);
+    }
+
+    constexpr void reset(const size_t bit)
+    {
+        words[bit / word_bits] &= ~(word(1) << (bit % word_bits));
+    }
+
+    constexpr void clear()
+    {
+        words.fill(0);
+    }
+
+    constexpr bool none() const
+    {
+        word any = 0;
+        for (const auto w : words)
+        {
+            any |= w;
+        }
+        return any == 0;
+    }
+
+    /// @brief Checks if any bit is set in both bitsets.
+    constexpr bool intersects(const word_bitset &other) const
+    {
+        word any = 0;
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            any |= words[i] & other.words[i];
+        }
+        return any != 0;
+    }
+
+    constexpr word_bitset &operator|=(const word_bitset &other)
+    {
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    constexpr word_bitset &operator&=(const word_bitset &other)
+    {
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            words[i] &= other.words[i];
+        }
+        return *this;
+    }
+
+    constexpr word_bitset &operator^=(const word_bitset &other)
+    {
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            words[i] ^= other.words[i];
+        }
+        return *this;
+    }
+
+    constexpr bool operator==(const word_bitset &other) const = default;
+
+    /// @brief Clears all bits which are set in the other bitset.
+    constexpr word_bitset &reset(const word_bitset &other)
+    {
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            words[i] &= ~other.words[i];
+        }
+        return *this;
+    }
+
+    /// @brief Calls a function with the index of every set bit, in ascending order.
+    template <typename Function>
+    constexpr void for_each(Function &&function) const
+    {
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            for (auto w = words[i]; w != 0; w &= w - 1)
+            {
+                function(i * word_bits + static_cast<size_t>(std::countr_zero(w)));
+            }
+        }
+    }
+};
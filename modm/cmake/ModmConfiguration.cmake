@@ -312,12 +312,12 @@ function(modm_targets_create project_name)
 
   add_custom_command(TARGET ${project_name}
     POST_BUILD
-    COMMAND cmake -E env PYTHONPATH=${PROJECT_SOURCE_DIR}/modm ${Python3_EXECUTABLE} -m modm_tools.size ${project_name}.elf \"[{'name': 'flash', 'access': 'rx', 'start': 134217728, 'size': 524288}, {'name': 'sram1', 'access': 'rwx', 'start': 536870912, 'size': 131072}]\")
+    COMMAND cmake -E env PYTHONPATH=${PROJECT_SOURCE_DIR}/modm ${Python3_EXECUTABLE} -m modm_tools.size ${project_name}.elf \"[{'name': 'flash', 'access': 'rx', 'start': 134217728, 'size': 393216}, {'name': 'sram1', 'access': 'rwx', 'start': 536870912, 'size': 131072}]\")
   add_custom_target(size DEPENDS ${project_name}.elf)
   add_custom_command(TARGET size
     POST_BUILD
     USES_TERMINAL
-    COMMAND cmake -E env PYTHONPATH=modm ${Python3_EXECUTABLE} -m modm_tools.size ${PROJECT_BINARY_DIR}/${project_name}.elf \"[{'name': 'flash', 'access': 'rx', 'start': 134217728, 'size': 524288}, {'name': 'sram1', 'access': 'rwx', 'start': 536870912, 'size': 131072}]\"
+    COMMAND cmake -E env PYTHONPATH=modm ${Python3_EXECUTABLE} -m modm_tools.size ${PROJECT_BINARY_DIR}/${project_name}.elf \"[{'name': 'flash', 'access': 'rx', 'start': 134217728, 'size': 393216}, {'name': 'sram1', 'access': 'rwx', 'start': 536870912, 'size': 131072}]\"
     WORKING_DIRECTORY ${PROJECT_SOURCE_DIR})
 
   add_custom_target(program DEPENDS ${project_name}.elf)
@@ -43,6 +43,7 @@
 #include "platform/timer/basic_base.hpp"
 #include "platform/timer/general_purpose_base.hpp"
 #include "platform/timer/timer_1.hpp"
+#include "platform/timer/timer_7.hpp"
 #include "platform/uart/uart.hpp"
 #include "platform/uart/uart_base.hpp"
 #include "platform/uart/uart_buffer.hpp"
@@ -22,7 +22,6 @@
 // ----------------------------------------------------------------------------
 // Default implementation of platform initialization
 modm_weak void modm_initialize_platform(void) {}
-extern void __modm_initialize_memory(void);
 extern int main(void);
 
 // ----------------------------------------------------------------------------
@@ -111,9 +110,6 @@ void __modm_startup(void)
 	table_copy(__table_copy_extern_start, __table_copy_extern_end);
 	table_zero(__table_zero_extern_start, __table_zero_extern_end);
 
-	// Initialize heap as implemented by the heap option
-	__modm_initialize_memory();
-
 	// Call all constructors of static objects
 	table_call(__init_array_start, __init_array_end);
 
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2009, Martin Rosekeit
+ * Copyright (c) 2009-2012, 2017, Fabian Greif
+ * Copyright (c) 2011, 2014, Georgi Grinshpun
+ * Copyright (c) 2013, 2016, Kevin Läufer
+ * Copyright (c) 2014-2017, Niklas Hauser
+ *
+ * This file is part of the modm project.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_STM32_TIMER_7_HPP
+#define MODM_STM32_TIMER_7_HPP
+
+#include <chrono>
+#include <limits>
+#include "basic_base.hpp"
+
+namespace modm::platform
+{
+
+/**
+ * @brief		Basic Timer 7
+ *
+ * Interrupt handler:
+ * - TIM7
+ *
+ * Example:
+ * @code
+ * MODM_ISR(TIM7)
+ * {
+ *     Timer7::acknowledgeInterruptFlags(Timer7::InterruptFlag::Update);
+ *
+ *     ...
+ * }
+ * @endcode
+ *
+ * @author		Fabian Greif
+ * @ingroup		modm_platform_timer
+ */
+class Timer7 : public BasicTimer
+{
+public:
+	// This type is the internal size of the counter.
+	using Value = uint16_t;
+
+	static void
+	enable();
+
+	static void
+	disable();
+
+	static bool
+	isEnabled();
+
+	static inline void
+	pause()
+	{
+		TIM7->CR1 &= ~TIM_CR1_CEN;
+	}
+
+	static inline void
+	start()
+	{
+		TIM7->CR1 |= TIM_CR1_CEN;
+	}
+
+	static void
+	setMode(Mode mode);
+
+	static inline void
+	setPrescaler(uint16_t prescaler)
+	{
+		// Because a prescaler of zero is not possible the actual
+		// prescaler value is \p prescaler - 1 (see Datasheet)
+		TIM7->PSC = prescaler - 1;
+	}
+
+	static uint16_t
+	getPrescaler()
+	{
+		return TIM7->PSC + 1;
+	}
+
+	static inline void
+	setOverflow(Value overflow)
+	{
+		TIM7->ARR = overflow;
+	}
+
+	static inline Value
+	getOverflow()
+	{
+		return TIM7->ARR;
+	}
+
+	template<class SystemClock>
+	static constexpr uint32_t
+	getClockFrequency()
+	{
+		return SystemClock::Timer7;
+	}
+
+	template<class SystemClock, class Rep, class Period>
+	static Value
+	setPeriod(std::chrono::duration<Rep, Period> duration, bool autoApply = true)
+	{
+		// This will be inaccurate for non-smooth frequencies (last six digits unequal to zero)
+		const uint32_t cycles = duration.count() * SystemClock::Timer7 * Period::num / Period::den;
+		const uint16_t prescaler = (cycles + std::numeric_limits<Value>::max() - 1) / std::numeric_limits<Value>::max();	// always round up
+		const Value overflow = cycles / prescaler - 1;
+
+		setPrescaler(prescaler);
+		setOverflow(overflow);
+
+		// Generate Update Event to apply the new settings for ARR
+		if (autoApply) {
+			applyAndReset();
+		}
+
+		return overflow;
+	}
+
+	static inline void
+	applyAndReset()
+	{
+		// Generate Update Event to apply the new settings for ARR
+		TIM7->EGR |= TIM_EGR_UG;
+	}
+
+	static inline Value
+	getValue()
+	{
+		return TIM7->CNT;
+	}
+
+	static inline void
+	setValue(Value value)
+	{
+		TIM7->CNT = value;
+	}
+
+	static void
+	enableInterruptVector(bool enable, uint8_t priority);
+
+	static inline void
+	enableInterrupt(Interrupt_t interrupt)
+	{
+		TIM7->DIER |= interrupt.value;
+	}
+
+	static inline void
+	disableInterrupt(Interrupt_t interrupt)
+	{
+		TIM7->DIER &= ~interrupt.value;
+	}
+
+	static inline InterruptFlag_t
+	getInterruptFlags()
+	{
+		return InterruptFlag_t(TIM7->SR);
+	}
+
+	static inline void
+	acknowledgeInterruptFlags(InterruptFlag_t flags)
+	{
+		// Flags are cleared by writing a zero to the flag position.
+		// Writing a one is ignored.
+		TIM7->SR = ~flags.value;
+	}
+};
+
+}	// namespace modm::platform
+
+#endif // MODM_STM32_TIMER_7_HPP